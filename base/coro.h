@@ -0,0 +1,355 @@
+#ifndef __base_coro_h__
+#define __base_coro_h__
+
+#include "base/def.h"
+
+#if defined(BASE_HAS_COROUTINES)
+
+#include "base/future.hpp"
+#include "base/task.h"
+#include "base/task_allocator.h"
+#include "base/time_ticks.h"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace base
+{
+    // Resumes a suspended coroutine from a task queue. It sits in the
+    // awaiter, and so in the coroutine frame, which makes a hop free.
+    class ResumeTask : public IntrusiveTask
+    {
+    public:
+        void SetCoroutine(std::coroutine_handle<> coroutine)
+        {
+            coroutine_ = coroutine;
+        }
+
+        virtual void Run()
+        {
+            coroutine_.resume();
+        }
+
+        // A flow whose resumption is dropped because its center went away
+        // stays suspended, and its frame goes with the Coro that owns it.
+        virtual void Abandon() {}
+
+    private:
+        std::coroutine_handle<> coroutine_;
+    };
+
+    /*
+     * Returned by TaskCenter::Switch and TaskCenter::Sleep. co_await
+     * yields true once the coroutine runs on the center, or false right
+     * away, still on the current thread, if the center refused the post.
+     */
+    template<typename Center>
+    class CenterAwaiter
+    {
+    public:
+        CenterAwaiter(Center* center, TaskPriority priority)
+            : center_(center), priority_(priority), delayed_(false), posted_(false) {}
+
+        CenterAwaiter(Center* center, const TimeDelta& delay)
+            : center_(center), priority_(PRIORITY_NORMAL), delay_(delay), delayed_(true), posted_(false) {}
+
+        bool await_ready() const
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> coroutine)
+        {
+            // once posted the coroutine may resume, and this awaiter go
+            // away, before the post call returns
+            resume_task_.SetCoroutine(coroutine);
+            posted_ = true;
+
+            bool posted = delayed_ ? center_->PostIntrusiveDelayTask(&resume_task_, delay_)
+                                   : center_->PostIntrusiveTask(&resume_task_, priority_);
+            if (!posted)
+            {
+                posted_ = false;
+            }
+
+            return posted;
+        }
+
+        bool await_resume() const
+        {
+            return posted_;
+        }
+
+    private:
+        Center*      center_;
+        TaskPriority priority_;
+        TimeDelta    delay_;
+        bool         delayed_;
+        bool         posted_;
+        ResumeTask   resume_task_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(CenterAwaiter)
+    };
+
+    /*
+     * Waits for a Future completed on any thread and resumes on center.
+     * co_await gives the future back, ready or broken. If the center has
+     * stopped the coroutine resumes on the completing thread instead.
+     */
+    template<typename Center, typename T>
+    class FutureAwaiter : public FutureCallback<typename FutureValue<T>::Type>
+    {
+    public:
+        typedef typename FutureValue<T>::Type ValueType;
+
+        FutureAwaiter(Center* center, Future<T>&& future)
+            : center_(center), state_(future.Detach()) {}
+
+        ~FutureAwaiter()
+        {
+            if (state_)
+                state_->Release();
+        }
+
+        // even a ready future hops, so the coroutine always carries on
+        // on center
+        bool await_ready() const
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine)
+        {
+            resume_task_.SetCoroutine(coroutine);
+            if (state_)
+                state_->SetCallback(this);
+            else
+                Resume();
+        }
+
+        Future<T> await_resume()
+        {
+            FutureState<ValueType>* state = state_;
+            state_ = 0;
+            return Future<T>(state);
+        }
+
+        virtual void OnReady(FutureState<ValueType>*)
+        {
+            Resume();
+        }
+
+        virtual void OnBroken()
+        {
+            Resume();
+        }
+
+    private:
+        void Resume()
+        {
+            if (!center_->PostIntrusiveTask(&resume_task_))
+            {
+                resume_task_.Run();
+            }
+        }
+
+    private:
+        Center*                 center_;
+        FutureState<ValueType>* state_;
+        ResumeTask              resume_task_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(FutureAwaiter)
+    };
+
+    template<typename Center, typename T>
+    FutureAwaiter<Center, T> ResumeOn(Center* center, Future<T>&& future)
+    {
+        return FutureAwaiter<Center, T>(center, std::move(future));
+    }
+
+    template<typename T> class Coro;
+
+    class CoroPromiseBase
+    {
+    public:
+        CoroPromiseBase() : detached_(false) {}
+
+        // frames come from the same per-thread free lists as tasks
+        static void* operator new(size_t size)
+        {
+            return TaskAllocator::Alloc(size);
+        }
+
+        static void operator delete(void* ptr)
+        {
+            TaskAllocator::Free(ptr);
+        }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> coroutine) noexcept
+            {
+                CoroPromiseBase& promise = coroutine.promise();
+                if (promise.continuation_)
+                    return promise.continuation_;
+
+                if (promise.detached_)
+                    coroutine.destroy();
+
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+
+        FinalAwaiter final_suspend() noexcept
+        {
+            return FinalAwaiter();
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+    private:
+        template<typename T> friend class Coro;
+
+        std::coroutine_handle<> continuation_;
+        bool                    detached_;
+    };
+
+    template<typename T>
+    class CoroPromise : public CoroPromiseBase
+    {
+    public:
+        Coro<T> get_return_object();
+
+        template<typename U>
+        void return_value(U&& value)
+        {
+            value_.emplace(std::forward<U>(value));
+        }
+
+    private:
+        template<typename U> friend class Coro;
+
+        std::optional<T> value_;
+    };
+
+    template<>
+    class CoroPromise<void> : public CoroPromiseBase
+    {
+    public:
+        Coro<void> get_return_object();
+
+        void return_void() {}
+    };
+
+    /*
+     * A lazily started coroutine. It runs when awaited from another
+     * coroutine, which resumes where the Coro finished (on whatever
+     * center it last switched to), or from Start() as a detached flow
+     * that frees its own frame at the end.
+     */
+    template<typename T = void>
+    class Coro
+    {
+    public:
+        typedef CoroPromise<T> promise_type;
+        typedef std::coroutine_handle<promise_type> Handle;
+
+        Coro() {}
+        explicit Coro(Handle coroutine) : coroutine_(coroutine) {}
+        Coro(Coro&& other) : coroutine_(other.coroutine_)
+        {
+            other.coroutine_ = Handle();
+        }
+
+        ~Coro()
+        {
+            if (coroutine_)
+                coroutine_.destroy();
+        }
+
+        // runs up to the first suspension on the calling thread
+        void Start()
+        {
+            Handle coroutine = coroutine_;
+            coroutine_ = Handle();
+
+            coroutine.promise().detached_ = true;
+            coroutine.resume();
+        }
+
+        bool IsDone() const
+        {
+            return !coroutine_ || coroutine_.done();
+        }
+
+        struct Awaiter
+        {
+            bool await_ready() const
+            {
+                return !coroutine || coroutine.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation)
+            {
+                coroutine.promise().continuation_ = continuation;
+                return coroutine;
+            }
+
+            T await_resume()
+            {
+                if constexpr (!std::is_void<T>::value)
+                    return std::move(*coroutine.promise().value_);
+            }
+
+            Handle coroutine;
+        };
+
+        Awaiter operator co_await() &&
+        {
+            Awaiter awaiter = { coroutine_ };
+            return awaiter;
+        }
+
+    private:
+        Handle coroutine_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(Coro)
+    };
+
+    template<typename T>
+    Coro<T> CoroPromise<T>::get_return_object()
+    {
+        return Coro<T>(Coro<T>::Handle::from_promise(*this));
+    }
+
+    inline Coro<void> CoroPromise<void>::get_return_object()
+    {
+        return Coro<void>(Coro<void>::Handle::from_promise(*this));
+    }
+}
+
+#endif
+
+#endif
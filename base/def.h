@@ -5,4 +5,44 @@
     theclass(const theclass&);\
     void operator=(const theclass&);
 
-#endif
\ No newline at end of file
+// VS2012 (v110) has rvalue references but no variadic templates
+#if !defined(_MSC_VER) || _MSC_VER >= 1800
+#define BASE_HAS_VARIADIC_TEMPLATES 1
+#endif
+
+// C++20 coroutines, for base/coro.h
+#if defined(__cpp_impl_coroutine) || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#define BASE_HAS_COROUTINES 1
+#endif
+
+// keeps a cold path out of an inlined caller
+#if defined(_MSC_VER)
+#define BASE_NOINLINE __declspec(noinline)
+#else
+#define BASE_NOINLINE __attribute__((noinline))
+#endif
+
+// aligns a type to n bytes, a cache line usually; operator new before
+// C++17 only honours it up to the default alignment
+#if defined(_MSC_VER)
+#define BASE_ALIGNAS(n) __declspec(align(n))
+#else
+#define BASE_ALIGNAS(n) __attribute__((aligned(n)))
+#endif
+
+// checks compiled into debug builds only
+#if defined(NDEBUG)
+#define BASE_DCHECK(condition) ((void)0)
+#else
+#include <assert.h>
+#define BASE_DCHECK(condition) assert(condition)
+#endif
+
+// thread-local storage for POD values
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#include "delay_task_queue.h"
+#include "task_handle.h"
+
+namespace base
+{
+    DelayTaskQueue::DelayTaskQueue()
+        : sequence_(0) {}
+
+    DelayTaskQueue::~DelayTaskQueue()
+    {
+        Clear();
+    }
+
+    DelayTaskQueue::Handle DelayTaskQueue::Push(Task* task, const TimeTicks& expire_time)
+    {
+        Entry entry;
+        entry.task = task;
+        entry.expire_time = expire_time;
+        entry.sequence = sequence_++;
+        queue_.push(entry);
+        return task;
+    }
+
+    Task* DelayTaskQueue::Remove(Handle handle)
+    {
+        removed_.insert(handle);
+        DropRemovedTop();
+        return 0;
+    }
+
+    Task* DelayTaskQueue::PopExpired(const TimeTicks& now)
+    {
+        if (queue_.empty() || queue_.top().expire_time > now)
+            return 0;
+
+        Task* task = queue_.top().task;
+        queue_.pop();
+        DropRemovedTop();
+        return task;
+    }
+
+    TimeTicks DelayTaskQueue::NextExpireTime() const
+    {
+        if (queue_.empty())
+            return TimeTicks();
+
+        return queue_.top().expire_time;
+    }
+
+    bool DelayTaskQueue::Empty() const
+    {
+        return queue_.empty();
+    }
+
+    void DelayTaskQueue::Clear()
+    {
+        while (!queue_.empty())
+        {
+            TaskSlotTable::Discard(queue_.top().task);
+            queue_.pop();
+        }
+
+        removed_.clear();
+    }
+
+    void DelayTaskQueue::DropRemovedTop()
+    {
+        while (!removed_.empty() && !queue_.empty())
+        {
+            Task* task = queue_.top().task;
+            if (!removed_.erase(task))
+                break;
+
+            queue_.pop();
+            TaskSlotTable::Discard(task);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef __base_delay_task_queue_h__
+#define __base_delay_task_queue_h__
+
+#include "base/def.h"
+#include "base/task.h"
+#include "base/time_ticks.h"
+
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+namespace base
+{
+    /*
+     * Binary-heap store for delayed tasks, the default DelayQueue of
+     * TaskCenter. Tasks with the same expire time run in the order they
+     * were pushed; NextExpireTime() is null when the queue is empty.
+     * Tasks are TaskSlotTable slot tasks, and Clear() and the destructor
+     * discard what is left through the table.
+     *
+     * A heap cannot take out an entry in the middle cheaply, so Remove()
+     * is lazy: the task is noted and discarded once it reaches the top.
+     * The top is kept live, so Empty() and NextExpireTime() never see a
+     * removed task.
+     */
+    class DelayTaskQueue
+    {
+    public:
+        typedef Task* Handle;
+
+        DelayTaskQueue();
+        ~DelayTaskQueue();
+
+        Handle    Push(Task* task, const TimeTicks& expire_time);
+        // Returns the task if it came out now, 0 if it is discarded later.
+        Task*     Remove(Handle handle);
+        Task*     PopExpired(const TimeTicks& now);
+        TimeTicks NextExpireTime() const;
+        bool      Empty() const;
+        void      Clear();
+
+    private:
+        struct Entry
+        {
+            Task*     task;
+            TimeTicks expire_time;
+            long long sequence;
+
+            // std::priority_queue keeps the greatest entry on top
+            bool operator< (const Entry& entry) const
+            {
+                if (expire_time != entry.expire_time)
+                    return expire_time > entry.expire_time;
+                return sequence > entry.sequence;
+            }
+        };
+
+        void DropRemovedTop();
+
+        std::priority_queue<Entry> queue_;
+        std::unordered_set<Task*>  removed_;
+        long long                  sequence_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(DelayTaskQueue)
+    };
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __base_epoll_pump_h__
+#define __base_epoll_pump_h__
+
+#include "def.h"
+#include "locker.h"
+#include "time_ticks.h"
+
+#include <atomic>
+
+namespace base
+{
+    /*
+     * Linux counterpart of MessagePump. Task wakeups come through an
+     * eventfd and delayed tasks through a timerfd, both multiplexed by
+     * a single epoll_wait in RunLoop.
+     */
+    template<typename Processor>
+    class EpollPump
+    {
+    public:
+        EpollPump();
+        ~EpollPump();
+
+        // once per pump; a Quit() that comes first makes it return at once
+        int  Run(Processor* processor);
+        void Quit(int code);
+        bool ScheduleTask();
+        bool ScheduleDelayTask(const TimeTicks& delayed_run_time);
+
+        // ScheduleTask from the pump's own thread, inside a callback
+        bool ScheduleLocalTask();
+
+    private:
+        void InitEpoll();
+        void UninitEpoll();
+
+        void RunLoop();
+        bool WaitForWork(int timeout);
+        bool ProcessEvent(int fd);
+
+        void HandleTaskEvent();
+        void HandleTimerEvent();
+
+    private:
+        struct RunState
+        {
+            Processor* processor;
+
+            std::atomic<bool> should_quit;
+            int code;
+        };
+
+        RunState                   state_;
+        int                        epoll_fd_;
+        int                        wakeup_fd_;
+        int                        timer_fd_;
+        std::atomic<long>          have_task_;
+        bool                       more_task_;
+        MultiThreadGuard<CSLocker> timer_locker_;
+        TimeTicks                  delayed_run_time_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(EpollPump)
+    };
+}
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef __base_epoll_pump_hpp__
+#define __base_epoll_pump_hpp__
+
+#include "epoll_pump.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+namespace base
+{
+    static const int kMaxEpollEvents = 4;
+
+    template<typename Processor>
+    EpollPump<Processor>::EpollPump()
+        : epoll_fd_(-1)
+        , wakeup_fd_(-1)
+        , timer_fd_(-1)
+        , have_task_(0L)
+        , more_task_(false)
+    {
+        state_.processor = 0;
+        state_.should_quit = false;
+        state_.code = 0;
+
+        InitEpoll();
+    }
+
+    template<typename Processor>
+    EpollPump<Processor>::~EpollPump()
+    {
+        UninitEpoll();
+    }
+
+    template<typename Processor>
+    int EpollPump<Processor>::Run(Processor* processor)
+    {
+        // should_quit and code keep what the constructor set: the center
+        // is RUNNING before it gets here, and a Quit() from another
+        // thread in between must not be overwritten
+        state_.processor = processor;
+
+        RunLoop();
+
+        return state_.code;
+    }
+
+    template<typename Processor>
+    void EpollPump<Processor>::Quit(int code)
+    {
+        state_.code = code;
+        state_.should_quit.store(true, std::memory_order_release);
+
+        uint64_t one = 1;
+        ::write(wakeup_fd_, &one, sizeof(one));
+    }
+
+    template<typename Processor>
+    bool EpollPump<Processor>::ScheduleTask()
+    {
+        if (have_task_.exchange(1L))
+        {
+            return false;
+        }
+
+        uint64_t one = 1;
+        ::write(wakeup_fd_, &one, sizeof(one));
+        return true;
+    }
+
+    template<typename Processor>
+    bool EpollPump<Processor>::ScheduleLocalTask()
+    {
+        // nobody is blocked in epoll_wait, so no eventfd write and read;
+        // RunLoop drains the queue before it blocks again
+        more_task_ = true;
+        return true;
+    }
+
+    template<typename Processor>
+    bool EpollPump<Processor>::ScheduleDelayTask(const TimeTicks& delayed_run_time)
+    {
+        AutoLocker<CSLocker> guard(&timer_locker_);
+        if (!delayed_run_time_.is_null() && delayed_run_time_ <= delayed_run_time)
+        {
+            return false;
+        }
+
+        delayed_run_time_ = delayed_run_time;
+
+        // TimeTicks and the timerfd share CLOCK_MONOTONIC, so the deadline
+        // is armed as is; a deadline already past fires at once
+        long long ns = delayed_run_time.ToInternalValue();
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = ns / 1000000000LL;
+        spec.it_value.tv_nsec = ns % 1000000000LL;
+        if (ns <= 0)
+        {
+            spec.it_value.tv_nsec = 1;
+        }
+
+        ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, 0);
+        return true;
+    }
+
+    template<typename Processor>
+    void EpollPump<Processor>::InitEpoll()
+    {
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+
+        event.data.fd = wakeup_fd_;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event);
+
+        event.data.fd = timer_fd_;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event);
+    }
+
+    template<typename Processor>
+    void EpollPump<Processor>::UninitEpoll()
+    {
+        if (timer_fd_ >= 0)
+            ::close(timer_fd_);
+        if (wakeup_fd_ >= 0)
+            ::close(wakeup_fd_);
+        if (epoll_fd_ >= 0)
+            ::close(epoll_fd_);
+    }
+
+    template<typename Processor>
+    void EpollPump<Processor>::RunLoop()
+    {
+        bool more_work = false;
+        while (true)
+        {
+            // only block when the previous pass left nothing to do, an
+            // idle task posting to this thread included
+            more_work = WaitForWork(more_work || more_task_ ? 0 : -1);
+            if (state_.should_quit)
+            {
+                break;
+            }
+
+            if (more_work)
+            {
+                continue;
+            }
+
+            more_work |= state_.processor->DoIdleTask();
+            if (state_.should_quit)
+            {
+                break;
+            }
+        }
+    }
+
+    template<typename Processor>
+    bool EpollPump<Processor>::WaitForWork(int timeout)
+    {
+        struct epoll_event events[kMaxEpollEvents];
+        int count = ::epoll_wait(epoll_fd_, events, kMaxEpollEvents, timeout);
+        if (count < 0 && errno != EINTR)
+        {
+            state_.should_quit = true;
+            return false;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            ProcessEvent(events[i].data.fd);
+            if (state_.should_quit)
+            {
+                return false;
+            }
+        }
+
+        // the eventfd is not rewritten while the processor reports more
+        // tasks, the queue is drained straight from the loop instead
+        if (more_task_)
+        {
+            HandleTaskEvent();
+        }
+
+        return more_task_;
+    }
+
+    template<typename Processor>
+    bool EpollPump<Processor>::ProcessEvent(int fd)
+    {
+        uint64_t count = 0;
+        if (::read(fd, &count, sizeof(count)) != sizeof(count))
+        {
+            return false;
+        }
+
+        if (fd == wakeup_fd_)
+        {
+            have_task_.store(0L);
+            more_task_ = true;
+        }
+        else if (fd == timer_fd_)
+        {
+            HandleTimerEvent();
+        }
+
+        return true;
+    }
+
+    template<typename Processor>
+    void EpollPump<Processor>::HandleTaskEvent()
+    {
+        more_task_ = state_.processor->DoTask();
+    }
+
+    template<typename Processor>
+    void EpollPump<Processor>::HandleTimerEvent()
+    {
+        {
+            AutoLocker<CSLocker> guard(&timer_locker_);
+            delayed_run_time_ = TimeTicks();
+        }
+
+        TimeTicks delayed_run_time;
+        bool more_delay_work = state_.processor->DoDelayTask(&delayed_run_time);
+        if (more_delay_work)
+        {
+            ScheduleDelayTask(delayed_run_time);
+        }
+    }
+}
+
+#endif
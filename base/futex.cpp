@@ -0,0 +1,90 @@
+#include "futex.h"
+
+#if defined(__linux__)
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <sched.h>
+#endif
+
+namespace base
+{
+#if defined(_WIN32) && defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+#pragma comment(lib, "Synchronization.lib")
+
+    void FutexWait(std::atomic<int>* word, int expected, const TimeTicks& deadline)
+    {
+        DWORD timeout = INFINITE;
+        if (!deadline.is_null())
+        {
+            long long ms = (deadline - TimeTicks::Now()).InMillisecondsRoundedUp();
+            if (ms <= 0)
+                return;
+
+            timeout = ms < INFINITE ? (DWORD)ms : INFINITE - 1;
+        }
+
+        ::WaitOnAddress(word, &expected, sizeof(expected), timeout);
+    }
+
+    void FutexWakeOne(std::atomic<int>* word)
+    {
+        ::WakeByAddressSingle(word);
+    }
+
+    void FutexWakeAll(std::atomic<int>* word)
+    {
+        ::WakeByAddressAll(word);
+    }
+#elif defined(_WIN32)
+    // no address wait before Windows 8, give the slice away instead
+    void FutexWait(std::atomic<int>*, int, const TimeTicks&)
+    {
+        ::SwitchToThread();
+    }
+
+    void FutexWakeOne(std::atomic<int>*) {}
+    void FutexWakeAll(std::atomic<int>*) {}
+#elif defined(__linux__)
+    void FutexWait(std::atomic<int>* word, int expected, const TimeTicks& deadline)
+    {
+        if (deadline.is_null())
+        {
+            ::syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAIT_PRIVATE,
+                      expected, 0, 0, 0);
+            return;
+        }
+
+        // TimeTicks is CLOCK_MONOTONIC, which an absolute bitset wait
+        // takes as is
+        long long ns = deadline.ToInternalValue();
+        struct timespec abs_time;
+        abs_time.tv_sec = ns / 1000000000LL;
+        abs_time.tv_nsec = ns % 1000000000LL;
+        ::syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAIT_BITSET_PRIVATE,
+                  expected, &abs_time, 0, FUTEX_BITSET_MATCH_ANY);
+    }
+
+    void FutexWakeOne(std::atomic<int>* word)
+    {
+        ::syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAKE_PRIVATE,
+                  1, 0, 0, 0);
+    }
+
+    void FutexWakeAll(std::atomic<int>* word)
+    {
+        ::syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAKE_PRIVATE,
+                  INT_MAX, 0, 0, 0);
+    }
+#else
+    void FutexWait(std::atomic<int>*, int, const TimeTicks&)
+    {
+        sched_yield();
+    }
+
+    void FutexWakeOne(std::atomic<int>*) {}
+    void FutexWakeAll(std::atomic<int>*) {}
+#endif
+}
@@ -0,0 +1,24 @@
+#ifndef __base_futex_h__
+#define __base_futex_h__
+
+#include "base/time_ticks.h"
+
+#include <atomic>
+
+namespace base
+{
+    /*
+     * Sleeping on a 32-bit word: futex on Linux, WaitOnAddress on
+     * Windows 8+. Where neither exists the wait only yields the slice,
+     * so callers must loop on their own condition anyway.
+     */
+
+    // Blocks while *word holds expected, until woken or until deadline
+    // passes (a null deadline waits without limit). May return early.
+    void FutexWait(std::atomic<int>* word, int expected, const TimeTicks& deadline = TimeTicks());
+
+    void FutexWakeOne(std::atomic<int>* word);
+    void FutexWakeAll(std::atomic<int>* word);
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __base_futex_pump_h__
+#define __base_futex_pump_h__
+
+#include "def.h"
+#include "futex.h"
+#include "locker.h"
+#include "time_ticks.h"
+
+#include <atomic>
+
+namespace base
+{
+    /*
+     * A pump for threads that only run tasks. With nothing to do it
+     * spins a few microseconds, then parks on a futex word. Producers
+     * read that word after posting and only make a syscall when the
+     * pump is parked, so posting to a busy pump costs no syscall and
+     * a pump caught spinning picks the task up without a wakeup.
+     * Delayed tasks bound the park. It waits on no handles or fds; use
+     * EpollPump or MessagePump when the thread must also serve those.
+     */
+    template<typename Processor>
+    class FutexPump
+    {
+    public:
+        FutexPump();
+        ~FutexPump();
+
+        // once per pump; a Quit() that comes first makes it return at once
+        int  Run(Processor* processor);
+        void Quit(int code);
+        bool ScheduleTask();
+        bool ScheduleDelayTask(const TimeTicks& delayed_run_time);
+
+        // ScheduleTask from the pump's own thread, inside a callback
+        bool ScheduleLocalTask();
+
+    private:
+        void RunLoop();
+        void DoDueDelayTasks();
+        void WaitForWork();
+        bool Wake();
+
+    private:
+        enum WaitState
+        {
+            WAIT_RUNNING  = 0,  // busy, will look at the queues again
+            WAIT_SPINNING = 1,  // out of work, about to park
+            WAIT_PARKED   = 2,  // asleep on the word, needs a wake
+            WAIT_NOTIFIED = 3   // woken, or told not to park
+        };
+
+        static const int kCacheLineSize = 64;
+        static const int kSpinMicroseconds = 20;
+        static const int kPausesPerClockRead = 64;
+
+        struct RunState
+        {
+            Processor* processor;
+
+            std::atomic<bool> should_quit;
+            int code;
+        };
+
+        // written by every producer, so kept off the consumer's lines
+        std::atomic<int>           wait_state_;
+        char                       pad_[kCacheLineSize - sizeof(std::atomic<int>)];
+        RunState                   state_;
+        bool                       spin_;
+        std::atomic<long long>     delayed_run_time_;
+        MultiThreadGuard<CSLocker> timer_locker_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(FutexPump)
+    };
+}
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef __base_futex_pump_hpp__
+#define __base_futex_pump_hpp__
+
+#include "futex_pump.h"
+
+#include <thread>
+
+namespace base
+{
+    template<typename Processor>
+    FutexPump<Processor>::FutexPump()
+        : wait_state_(WAIT_RUNNING)
+        , delayed_run_time_(0)
+    {
+        state_.processor = 0;
+        state_.should_quit = false;
+        state_.code = 0;
+
+        // spinning for a producer that shares the only core just delays it
+        spin_ = std::thread::hardware_concurrency() > 1;
+    }
+
+    template<typename Processor>
+    FutexPump<Processor>::~FutexPump() {}
+
+    template<typename Processor>
+    int FutexPump<Processor>::Run(Processor* processor)
+    {
+        // should_quit and code keep what the constructor set: the center
+        // is RUNNING before it gets here, and a Quit() from another
+        // thread in between must not be overwritten
+        state_.processor = processor;
+
+        RunLoop();
+
+        return state_.code;
+    }
+
+    template<typename Processor>
+    void FutexPump<Processor>::Quit(int code)
+    {
+        state_.code = code;
+        state_.should_quit.store(true, std::memory_order_release);
+
+        Wake();
+    }
+
+    template<typename Processor>
+    bool FutexPump<Processor>::ScheduleTask()
+    {
+        return Wake();
+    }
+
+    template<typename Processor>
+    bool FutexPump<Processor>::ScheduleLocalTask()
+    {
+        // WaitForWork looks at the queues again before it parks
+        return false;
+    }
+
+    template<typename Processor>
+    bool FutexPump<Processor>::ScheduleDelayTask(const TimeTicks& delayed_run_time)
+    {
+        {
+            AutoLocker<CSLocker> guard(&timer_locker_);
+            long long current = delayed_run_time_.load(std::memory_order_relaxed);
+            if (current != 0 && current <= delayed_run_time.ToInternalValue())
+            {
+                return false;
+            }
+
+            delayed_run_time_.store(delayed_run_time.ToInternalValue(), std::memory_order_relaxed);
+        }
+
+        // a parked pump has to pick up the earlier deadline
+        Wake();
+        return true;
+    }
+
+    template<typename Processor>
+    bool FutexPump<Processor>::Wake()
+    {
+        // Pairs with the fence in WaitForWork: either the pump sees what
+        // was posted before this, or this sees the pump going to sleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int state = wait_state_.load(std::memory_order_relaxed);
+        if (state == WAIT_RUNNING || state == WAIT_NOTIFIED)
+        {
+            return false;
+        }
+
+        if (wait_state_.exchange(WAIT_NOTIFIED, std::memory_order_acq_rel) == WAIT_PARKED)
+        {
+            FutexWakeOne(&wait_state_);
+        }
+
+        return true;
+    }
+
+    template<typename Processor>
+    void FutexPump<Processor>::RunLoop()
+    {
+        while (true)
+        {
+            bool more_work = state_.processor->DoTask();
+            if (state_.should_quit)
+            {
+                break;
+            }
+
+            DoDueDelayTasks();
+            if (state_.should_quit)
+            {
+                break;
+            }
+
+            if (more_work)
+            {
+                continue;
+            }
+
+            more_work = state_.processor->DoIdleTask();
+            if (state_.should_quit)
+            {
+                break;
+            }
+
+            if (more_work)
+            {
+                continue;
+            }
+
+            WaitForWork();
+        }
+    }
+
+    template<typename Processor>
+    void FutexPump<Processor>::DoDueDelayTasks()
+    {
+        long long delayed_run_time = delayed_run_time_.load(std::memory_order_relaxed);
+        if (delayed_run_time == 0 || TimeTicks::Now().ToInternalValue() < delayed_run_time)
+        {
+            return;
+        }
+
+        {
+            AutoLocker<CSLocker> guard(&timer_locker_);
+            delayed_run_time_.store(0, std::memory_order_relaxed);
+        }
+
+        TimeTicks next_delayed_run_time;
+        if (state_.processor->DoDelayTask(&next_delayed_run_time))
+        {
+            ScheduleDelayTask(next_delayed_run_time);
+        }
+    }
+
+    template<typename Processor>
+    void FutexPump<Processor>::WaitForWork()
+    {
+        // Announce the wait before the last look at the queues, so a post
+        // that the look misses finds the pump no longer running.
+        wait_state_.store(WAIT_SPINNING, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        long long delayed_run_time = delayed_run_time_.load(std::memory_order_relaxed);
+        if (state_.should_quit || state_.processor->HasPendingWork() ||
+            (delayed_run_time != 0 && TimeTicks::Now().ToInternalValue() >= delayed_run_time))
+        {
+            wait_state_.store(WAIT_RUNNING, std::memory_order_relaxed);
+            return;
+        }
+
+        if (spin_)
+        {
+            TimeTicks spin_end = TimeTicks::Now() + TimeDelta::FromMicroseconds(kSpinMicroseconds);
+            while (wait_state_.load(std::memory_order_acquire) != WAIT_NOTIFIED)
+            {
+                for (int i = 0; i < kPausesPerClockRead; ++i)
+                    CpuRelax();
+
+                if (TimeTicks::Now() >= spin_end)
+                    break;
+            }
+        }
+        else
+        {
+            // on one core a producer can only post while this thread is
+            // off it; one yield lets it, and is cheaper than a park/wake
+            std::this_thread::yield();
+        }
+
+        // A notify from here on makes the exchange fail or the futex wait
+        // return at once. A new earlier deadline notifies too, so reading
+        // it before parking is enough.
+        int expected = WAIT_SPINNING;
+        if (wait_state_.compare_exchange_strong(expected, WAIT_PARKED, std::memory_order_acq_rel))
+        {
+            FutexWait(&wait_state_, WAIT_PARKED, TimeTicks::FromInternalValue(delayed_run_time));
+        }
+
+        wait_state_.store(WAIT_RUNNING, std::memory_order_relaxed);
+    }
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef __base_future_h__
+#define __base_future_h__
+
+#include "base/def.h"
+#include "base/task.h"
+#include "base/task_handle.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace base
+{
+    // value held by a Future<void>
+    struct FutureVoid {};
+
+    template<typename T> struct FutureValue       { typedef T          Type; };
+    template<>           struct FutureValue<void> { typedef FutureVoid Type; };
+
+    // what fn returns when it continues a Future<T>
+    template<typename F, typename T> struct FutureResultOf
+    {
+        typedef typename std::result_of<F(T&&)>::type Type;
+    };
+
+    template<typename F> struct FutureResultOf<F, void>
+    {
+        typedef typename std::result_of<F()>::type Type;
+    };
+
+    template<typename Value> class FutureState;
+
+    template<typename Value>
+    class FutureCallback
+    {
+    public:
+        virtual ~FutureCallback() {}
+
+        // Exactly one of these is called, once, on the thread that
+        // completes the state or attaches the callback. The callback
+        // owns itself from then on.
+        virtual void OnReady(FutureState<Value>* state) = 0;
+        virtual void OnBroken() = 0;
+    };
+
+    /*
+     * The state shared by a Promise, its Future and the continuation
+     * attached to it. Reference counted and carved from TaskAllocator
+     * like a task, so a link of a chain costs no trip to the global heap.
+     * Completion and attaching the callback race on one atomic word, and
+     * whichever comes second runs the callback.
+     */
+    template<typename Value>
+    class FutureState
+    {
+    public:
+        FutureState();
+        ~FutureState();
+
+        static void* operator new(size_t size);
+        static void  operator delete(void* ptr);
+
+        void AddRef();
+        void Release();
+
+        template<typename U>
+        void SetValue(U&& value);
+        void Abandon();
+        void SetCallback(FutureCallback<Value>* callback);
+
+        bool   IsReady() const;
+        Value& GetValue();
+
+    private:
+        enum
+        {
+            FLAG_READY        = 1,
+            FLAG_BROKEN       = 2,
+            FLAG_HAS_CALLBACK = 4
+        };
+
+        void Complete(unsigned int flag);
+        void Fire(unsigned int flags);
+
+    private:
+        std::atomic<long>         refs_;
+        std::atomic<unsigned int> flags_;
+        FutureCallback<Value>*    callback_;
+        typename std::aligned_storage<sizeof(Value),
+            std::alignment_of<Value>::value>::type storage_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(FutureState)
+    };
+
+    template<typename T> class Promise;
+
+    /*
+     * The read side of a one-shot result. Nothing ever blocks on it:
+     * Then() runs a continuation on an executor (TaskCenter, WorkerPool,
+     * SequencedTaskRunner, anything with PostTask(Task*)) once the value
+     * is set, and hands back the future of what the continuation returns.
+     * Then() consumes the future. If the promise is dropped without a
+     * value the future is broken, and continuations waiting on it are
+     * deleted without running, breaking the rest of the chain.
+     */
+    template<typename T>
+    class Future
+    {
+    public:
+        typedef typename FutureValue<T>::Type ValueType;
+
+        Future();
+        Future(Future&& other);
+        Future& operator=(Future&& other);
+        ~Future();
+
+        bool IsValid() const;
+        bool IsReady() const;
+
+        // only once IsReady()
+        ValueType& GetValue();
+
+        template<typename Executor, typename F>
+        Future<typename FutureResultOf<F, T>::Type> Then(Executor* executor, F&& fn);
+
+    private:
+        template<typename U> friend class Future;
+        template<typename U> friend class Promise;
+        template<typename C, typename U> friend class FutureAwaiter;
+        template<typename U> friend Future<std::vector<typename FutureValue<U>::Type> >
+            WhenAll(std::vector<Future<U> >& futures);
+        template<typename U> friend Future<std::pair<size_t, typename FutureValue<U>::Type> >
+            WhenAny(std::vector<Future<U> >& futures);
+
+        explicit Future(FutureState<ValueType>* state);
+        FutureState<ValueType>* Detach();
+
+    private:
+        FutureState<ValueType>* state_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(Future)
+    };
+
+    template<typename T>
+    class Promise
+    {
+    public:
+        typedef typename FutureValue<T>::Type ValueType;
+
+        Promise();
+        Promise(Promise&& other);
+        ~Promise();
+
+        // may be called once
+        Future<T> GetFuture();
+
+        void SetValue(const ValueType& value);
+        void SetValue(ValueType&& value);
+        void SetValue(); // Promise<void>
+
+    private:
+        FutureState<ValueType>* state_;
+        bool                    future_retrieved_;
+        bool                    satisfied_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(Promise)
+    };
+
+    // Ready once every input is, with the values in input order; broken
+    // if any input is. Consumes the futures.
+    template<typename T>
+    Future<std::vector<typename FutureValue<T>::Type> >
+    WhenAll(std::vector<Future<T> >& futures);
+
+    // Ready with the index and value of the first input to complete;
+    // broken only if every input is. Consumes the futures.
+    template<typename T>
+    Future<std::pair<size_t, typename FutureValue<T>::Type> >
+    WhenAny(std::vector<Future<T> >& futures);
+
+    // Runs work on executor, then posts reply to reply_executor. The
+    // returned handle cancels the work, and with it the reply. On a
+    // failed post both tasks still belong to the caller, unless the
+    // handle IsDropped().
+    template<typename Executor, typename ReplyExecutor>
+    TaskHandle PostTaskAndReply(Executor* executor, ReplyExecutor* reply_executor,
+                                Task* work, Task* reply);
+
+    // Runs fn on executor and returns the future of its result.
+    template<typename Executor, typename F>
+    Future<typename FutureResultOf<F, void>::Type> PostTaskWithResult(Executor* executor, F&& fn);
+}
+
+#endif
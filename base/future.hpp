@@ -0,0 +1,692 @@
+#ifndef __base_future_hpp__
+#define __base_future_hpp__
+
+#include "base/future.h"
+#include "base/task_allocator.h"
+
+#include <new>
+
+namespace base
+{
+    template<typename Value>
+    FutureState<Value>::FutureState()
+        : refs_(1)
+        , flags_(0)
+        , callback_(0) {}
+
+    template<typename Value>
+    FutureState<Value>::~FutureState()
+    {
+        if (IsReady())
+        {
+            GetValue().~Value();
+        }
+    }
+
+    template<typename Value>
+    void* FutureState<Value>::operator new(size_t size)
+    {
+        return TaskAllocator::Alloc(size);
+    }
+
+    template<typename Value>
+    void FutureState<Value>::operator delete(void* ptr)
+    {
+        TaskAllocator::Free(ptr);
+    }
+
+    template<typename Value>
+    void FutureState<Value>::AddRef()
+    {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template<typename Value>
+    void FutureState<Value>::Release()
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    template<typename Value>
+    template<typename U>
+    void FutureState<Value>::SetValue(U&& value)
+    {
+        new (&storage_) Value(std::forward<U>(value));
+        Complete(FLAG_READY);
+    }
+
+    template<typename Value>
+    void FutureState<Value>::Abandon()
+    {
+        Complete(FLAG_BROKEN);
+    }
+
+    template<typename Value>
+    void FutureState<Value>::SetCallback(FutureCallback<Value>* callback)
+    {
+        callback_ = callback;
+        unsigned int flags = flags_.fetch_or(FLAG_HAS_CALLBACK, std::memory_order_acq_rel);
+        if (flags & (FLAG_READY | FLAG_BROKEN))
+        {
+            Fire(flags);
+        }
+    }
+
+    template<typename Value>
+    bool FutureState<Value>::IsReady() const
+    {
+        return (flags_.load(std::memory_order_acquire) & FLAG_READY) != 0;
+    }
+
+    template<typename Value>
+    Value& FutureState<Value>::GetValue()
+    {
+        return *reinterpret_cast<Value*>(&storage_);
+    }
+
+    template<typename Value>
+    void FutureState<Value>::Complete(unsigned int flag)
+    {
+        unsigned int flags = flags_.fetch_or(flag, std::memory_order_acq_rel);
+        if (flags & FLAG_HAS_CALLBACK)
+        {
+            Fire(flag);
+        }
+    }
+
+    template<typename Value>
+    void FutureState<Value>::Fire(unsigned int flags)
+    {
+        FutureCallback<Value>* callback = callback_;
+        callback_ = 0;
+
+        if (flags & FLAG_READY)
+            callback->OnReady(this);
+        else
+            callback->OnBroken();
+    }
+
+    // Calls a continuation with the value of the future it follows and
+    // turns a void on either side into FutureVoid.
+    template<typename T, typename R>
+    struct FutureInvoker
+    {
+        template<typename F>
+        static R Invoke(F& fn, typename FutureValue<T>::Type& value)
+        {
+            return fn(std::move(value));
+        }
+    };
+
+    template<typename R>
+    struct FutureInvoker<void, R>
+    {
+        template<typename F>
+        static R Invoke(F& fn, FutureVoid&)
+        {
+            return fn();
+        }
+    };
+
+    template<typename T>
+    struct FutureInvoker<T, void>
+    {
+        template<typename F>
+        static FutureVoid Invoke(F& fn, typename FutureValue<T>::Type& value)
+        {
+            fn(std::move(value));
+            return FutureVoid();
+        }
+    };
+
+    template<>
+    struct FutureInvoker<void, void>
+    {
+        template<typename F>
+        static FutureVoid Invoke(F& fn, FutureVoid&)
+        {
+            fn();
+            return FutureVoid();
+        }
+    };
+
+    // The continuation of a Future<T>. It waits as the callback of the
+    // source state and is posted to the executor as is once the value is
+    // there. Deleted without running, it breaks the future it feeds.
+    template<typename T, typename R, typename F, typename Executor>
+    class ThenTask : public Task, public FutureCallback<typename FutureValue<T>::Type>
+    {
+    public:
+        typedef typename FutureValue<T>::Type SourceValue;
+        typedef typename FutureValue<R>::Type TargetValue;
+
+        template<typename G>
+        ThenTask(Executor* executor, G&& fn,
+                 FutureState<SourceValue>* source, FutureState<TargetValue>* target)
+            : executor_(executor)
+            , fn_(std::forward<G>(fn))
+            , source_(source)
+            , target_(target) {}
+
+        virtual ~ThenTask()
+        {
+            if (target_)
+            {
+                target_->Abandon();
+                target_->Release();
+            }
+            source_->Release();
+        }
+
+        virtual void Run()
+        {
+            target_->SetValue(FutureInvoker<T, R>::Invoke(fn_, source_->GetValue()));
+            target_->Release();
+            target_ = 0;
+        }
+
+        virtual void OnReady(FutureState<SourceValue>*)
+        {
+            // a dropped post has deleted us already
+            TaskHandle handle = executor_->PostTask(this);
+            if (!handle && !handle.IsDropped())
+            {
+                delete this;
+            }
+        }
+
+        virtual void OnBroken()
+        {
+            delete this;
+        }
+
+    private:
+        Executor*                  executor_;
+        F                          fn_;
+        FutureState<SourceValue>*  source_;
+        FutureState<TargetValue>*  target_;
+    };
+
+    template<typename T>
+    Future<T>::Future()
+        : state_(0) {}
+
+    template<typename T>
+    Future<T>::Future(FutureState<ValueType>* state)
+        : state_(state) {}
+
+    template<typename T>
+    Future<T>::Future(Future&& other)
+        : state_(other.Detach()) {}
+
+    template<typename T>
+    Future<T>& Future<T>::operator=(Future&& other)
+    {
+        if (this != &other)
+        {
+            if (state_)
+                state_->Release();
+            state_ = other.Detach();
+        }
+
+        return *this;
+    }
+
+    template<typename T>
+    Future<T>::~Future()
+    {
+        if (state_)
+        {
+            state_->Release();
+        }
+    }
+
+    template<typename T>
+    bool Future<T>::IsValid() const
+    {
+        return state_ != 0;
+    }
+
+    template<typename T>
+    bool Future<T>::IsReady() const
+    {
+        return state_ && state_->IsReady();
+    }
+
+    template<typename T>
+    typename Future<T>::ValueType& Future<T>::GetValue()
+    {
+        return state_->GetValue();
+    }
+
+    template<typename T>
+    template<typename Executor, typename F>
+    Future<typename FutureResultOf<F, T>::Type> Future<T>::Then(Executor* executor, F&& fn)
+    {
+        typedef typename FutureResultOf<F, T>::Type R;
+        typedef typename FutureValue<R>::Type TargetValue;
+        typedef ThenTask<T, R, typename std::decay<F>::type, Executor> Continuation;
+
+        if (!state_)
+        {
+            return Future<R>();
+        }
+
+        // one reference for the continuation, one for the returned future
+        FutureState<TargetValue>* target = new FutureState<TargetValue>();
+        target->AddRef();
+
+        FutureState<ValueType>* source = Detach();
+        source->SetCallback(new Continuation(executor, std::forward<F>(fn), source, target));
+
+        return Future<R>(target);
+    }
+
+    template<typename T>
+    FutureState<typename Future<T>::ValueType>* Future<T>::Detach()
+    {
+        FutureState<ValueType>* state = state_;
+        state_ = 0;
+        return state;
+    }
+
+    template<typename T>
+    Promise<T>::Promise()
+        : state_(new FutureState<ValueType>())
+        , future_retrieved_(false)
+        , satisfied_(false) {}
+
+    template<typename T>
+    Promise<T>::Promise(Promise&& other)
+        : state_(other.state_)
+        , future_retrieved_(other.future_retrieved_)
+        , satisfied_(other.satisfied_)
+    {
+        other.state_ = 0;
+    }
+
+    template<typename T>
+    Promise<T>::~Promise()
+    {
+        if (!state_)
+        {
+            return;
+        }
+
+        if (!satisfied_)
+        {
+            state_->Abandon();
+        }
+
+        state_->Release();
+    }
+
+    template<typename T>
+    Future<T> Promise<T>::GetFuture()
+    {
+        if (!state_ || future_retrieved_)
+        {
+            return Future<T>();
+        }
+
+        future_retrieved_ = true;
+        state_->AddRef();
+        return Future<T>(state_);
+    }
+
+    template<typename T>
+    void Promise<T>::SetValue(const ValueType& value)
+    {
+        if (!state_ || satisfied_)
+        {
+            return;
+        }
+
+        satisfied_ = true;
+        state_->SetValue(value);
+    }
+
+    template<typename T>
+    void Promise<T>::SetValue(ValueType&& value)
+    {
+        if (!state_ || satisfied_)
+        {
+            return;
+        }
+
+        satisfied_ = true;
+        state_->SetValue(std::move(value));
+    }
+
+    template<typename T>
+    void Promise<T>::SetValue()
+    {
+        static_assert(std::is_void<T>::value, "SetValue() without a value is for Promise<void>");
+        SetValue(FutureVoid());
+    }
+
+    // Gathers the inputs of WhenAll. Every input keeps its state until the
+    // last one completes, which moves the values out in input order and
+    // deletes the gatherer.
+    template<typename Value>
+    class WhenAllState
+    {
+    public:
+        typedef std::vector<Value> Result;
+
+        WhenAllState(size_t count, FutureState<Result>* target)
+            : inputs_(count)
+            , remaining_(count)
+            , broken_(false)
+            , target_(target)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                inputs_[i].owner = this;
+            }
+        }
+
+        ~WhenAllState()
+        {
+            for (size_t i = 0; i < inputs_.size(); ++i)
+            {
+                if (inputs_[i].source)
+                    inputs_[i].source->Release();
+            }
+
+            target_->Release();
+        }
+
+        void Watch(size_t index, FutureState<Value>* source)
+        {
+            inputs_[index].source = source;
+            source->SetCallback(&inputs_[index]);
+        }
+
+    private:
+        struct Input : public FutureCallback<Value>
+        {
+            Input() : owner(0), source(0) {}
+
+            virtual void OnReady(FutureState<Value>*)
+            {
+                owner->OnInputDone(false);
+            }
+
+            virtual void OnBroken()
+            {
+                owner->OnInputDone(true);
+            }
+
+            WhenAllState*       owner;
+            FutureState<Value>* source;
+        };
+
+        void OnInputDone(bool broken)
+        {
+            if (broken)
+            {
+                broken_.store(true, std::memory_order_relaxed);
+            }
+
+            if (remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            {
+                return;
+            }
+
+            if (broken_.load(std::memory_order_relaxed))
+            {
+                target_->Abandon();
+            }
+            else
+            {
+                Result result;
+                result.reserve(inputs_.size());
+                for (size_t i = 0; i < inputs_.size(); ++i)
+                {
+                    result.push_back(std::move(inputs_[i].source->GetValue()));
+                }
+                target_->SetValue(std::move(result));
+            }
+
+            delete this;
+        }
+
+    private:
+        std::vector<Input>   inputs_;
+        std::atomic<size_t>  remaining_;
+        std::atomic<bool>    broken_;
+        FutureState<Result>* target_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(WhenAllState)
+    };
+
+    template<typename T>
+    Future<std::vector<typename FutureValue<T>::Type> >
+    WhenAll(std::vector<Future<T> >& futures)
+    {
+        typedef typename FutureValue<T>::Type Value;
+        typedef std::vector<Value> Result;
+
+        FutureState<Result>* target = new FutureState<Result>();
+        if (futures.empty())
+        {
+            target->SetValue(Result());
+            return Future<Result>(target);
+        }
+
+        target->AddRef();
+        WhenAllState<Value>* state = new WhenAllState<Value>(futures.size(), target);
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            FutureState<Value>* source = futures[i].Detach();
+            if (!source)
+            {
+                // an invalid input never completes, treat it as broken
+                source = new FutureState<Value>();
+                source->Abandon();
+            }
+
+            state->Watch(i, source);
+        }
+
+        return Future<Result>(target);
+    }
+
+    // Gathers the inputs of WhenAny. The first input to complete claims
+    // the result, the last one to complete deletes the gatherer.
+    template<typename Value>
+    class WhenAnyState
+    {
+    public:
+        typedef std::pair<size_t, Value> Result;
+
+        WhenAnyState(size_t count, FutureState<Result>* target)
+            : inputs_(count)
+            , remaining_(count)
+            , claimed_(false)
+            , target_(target)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                inputs_[i].owner = this;
+                inputs_[i].index = i;
+            }
+        }
+
+        ~WhenAnyState()
+        {
+            for (size_t i = 0; i < inputs_.size(); ++i)
+            {
+                if (inputs_[i].source)
+                    inputs_[i].source->Release();
+            }
+
+            target_->Release();
+        }
+
+        void Watch(size_t index, FutureState<Value>* source)
+        {
+            inputs_[index].source = source;
+            source->SetCallback(&inputs_[index]);
+        }
+
+    private:
+        struct Input : public FutureCallback<Value>
+        {
+            Input() : owner(0), index(0), source(0) {}
+
+            virtual void OnReady(FutureState<Value>* state)
+            {
+                owner->OnInputDone(index, state);
+            }
+
+            virtual void OnBroken()
+            {
+                owner->OnInputDone(index, 0);
+            }
+
+            WhenAnyState*       owner;
+            size_t              index;
+            FutureState<Value>* source;
+        };
+
+        void OnInputDone(size_t index, FutureState<Value>* state)
+        {
+            if (state && !claimed_.exchange(true, std::memory_order_acq_rel))
+            {
+                target_->SetValue(Result(index, std::move(state->GetValue())));
+            }
+
+            if (remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            {
+                return;
+            }
+
+            if (!claimed_.load(std::memory_order_acquire))
+            {
+                target_->Abandon();
+            }
+
+            delete this;
+        }
+
+    private:
+        std::vector<Input>   inputs_;
+        std::atomic<size_t>  remaining_;
+        std::atomic<bool>    claimed_;
+        FutureState<Result>* target_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(WhenAnyState)
+    };
+
+    template<typename T>
+    Future<std::pair<size_t, typename FutureValue<T>::Type> >
+    WhenAny(std::vector<Future<T> >& futures)
+    {
+        typedef typename FutureValue<T>::Type Value;
+        typedef std::pair<size_t, Value> Result;
+
+        FutureState<Result>* target = new FutureState<Result>();
+        if (futures.empty())
+        {
+            target->Abandon();
+            return Future<Result>(target);
+        }
+
+        target->AddRef();
+        WhenAnyState<Value>* state = new WhenAnyState<Value>(futures.size(), target);
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            FutureState<Value>* source = futures[i].Detach();
+            if (!source)
+            {
+                source = new FutureState<Value>();
+                source->Abandon();
+            }
+
+            state->Watch(i, source);
+        }
+
+        return Future<Result>(target);
+    }
+
+    template<typename ReplyExecutor>
+    class TaskAndReplyTask : public Task
+    {
+    public:
+        TaskAndReplyTask(Task* work, ReplyExecutor* reply_executor, Task* reply)
+            : work_(work)
+            , reply_executor_(reply_executor)
+            , reply_(reply) {}
+
+        virtual ~TaskAndReplyTask()
+        {
+            delete work_;
+            delete reply_;
+        }
+
+        virtual void Run()
+        {
+            work_->Run();
+            delete work_;
+            work_ = 0;
+
+            TaskHandle handle = reply_executor_->PostTask(reply_);
+            if (handle || handle.IsDropped())
+            {
+                reply_ = 0;
+            }
+        }
+
+        // hands both tasks back after a failed post
+        void Release()
+        {
+            work_ = 0;
+            reply_ = 0;
+        }
+
+    private:
+        Task*          work_;
+        ReplyExecutor* reply_executor_;
+        Task*          reply_;
+    };
+
+    template<typename Executor, typename ReplyExecutor>
+    TaskHandle PostTaskAndReply(Executor* executor, ReplyExecutor* reply_executor,
+                                Task* work, Task* reply)
+    {
+        if (!work || !reply)
+        {
+            return TaskHandle();
+        }
+
+        TaskAndReplyTask<ReplyExecutor>* task =
+            new TaskAndReplyTask<ReplyExecutor>(work, reply_executor, reply);
+
+        TaskHandle handle = executor->PostTask(task);
+        if (!handle && !handle.IsDropped())
+        {
+            task->Release();
+            delete task;
+        }
+
+        return handle;
+    }
+
+    template<typename Executor, typename F>
+    Future<typename FutureResultOf<F, void>::Type> PostTaskWithResult(Executor* executor, F&& fn)
+    {
+        Promise<void> start;
+        Future<void> started = start.GetFuture();
+        start.SetValue();
+        return started.Then(executor, std::forward<F>(fn));
+    }
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include "histogram.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace base
+{
+    static inline int HighestBit(unsigned long long word)
+    {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanReverse64(&index, word);
+        return (int)index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanReverse(&index, (unsigned long)(word >> 32)))
+            return (int)index + 32;
+        _BitScanReverse(&index, (unsigned long)word);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(word);
+#endif
+    }
+
+    HistogramSnapshot::HistogramSnapshot()
+        : count(0)
+        , sum(0)
+        , max(0) {}
+
+    double HistogramSnapshot::Mean() const
+    {
+        return count ? (double)sum / count : 0.0;
+    }
+
+    long long HistogramSnapshot::Percentile(double percent) const
+    {
+        long long total = 0;
+        for (size_t i = 0; i < buckets.size(); ++i)
+            total += buckets[i];
+
+        if (!total)
+            return 0;
+
+        long long rank = (long long)(total * percent / 100.0);
+        if (rank >= total)
+            rank = total - 1;
+
+        long long seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i)
+        {
+            seen += buckets[i];
+            if (seen > rank)
+            {
+                // middle of the bucket, but never past the largest sample
+                long long low = Histogram::BucketLowerBound((int)i);
+                long long high = (int)i + 1 < Histogram::kBuckets ?
+                                 Histogram::BucketLowerBound((int)i + 1) : low;
+                long long value = low + (high - low) / 2;
+                return value < max ? value : max;
+            }
+        }
+
+        return max;
+    }
+
+    Histogram::Histogram()
+        : count_(0)
+        , sum_(0)
+        , max_(0)
+    {
+        for (int i = 0; i < kBuckets; ++i)
+            counts_[i].store(0, std::memory_order_relaxed);
+    }
+
+    void Histogram::Add(long long value)
+    {
+        if (value < 0)
+            value = 0;
+
+        counts_[BucketOf((unsigned long long)value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        long long max = max_.load(std::memory_order_relaxed);
+        while (value > max &&
+               !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void Histogram::Snapshot(HistogramSnapshot* snapshot) const
+    {
+        snapshot->count = count_.load(std::memory_order_relaxed);
+        snapshot->sum = sum_.load(std::memory_order_relaxed);
+        snapshot->max = max_.load(std::memory_order_relaxed);
+        snapshot->buckets.resize(kBuckets);
+        for (int i = 0; i < kBuckets; ++i)
+            snapshot->buckets[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+
+    int Histogram::BucketOf(unsigned long long value)
+    {
+        if (value < (unsigned long long)kSubBuckets)
+            return (int)value;
+
+        int shift = HighestBit(value) - kSubBucketBits;
+        int sub = (int)(value >> shift) & (kSubBuckets - 1);
+        return (shift + 1) * kSubBuckets + sub;
+    }
+
+    long long Histogram::BucketLowerBound(int bucket)
+    {
+        if (bucket < kSubBuckets)
+            return bucket;
+
+        int shift = bucket / kSubBuckets - 1;
+        int sub = bucket % kSubBuckets;
+        return (long long)((unsigned long long)(kSubBuckets + sub) << shift);
+    }
+}
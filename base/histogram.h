@@ -0,0 +1,61 @@
+#ifndef __base_histogram_h__
+#define __base_histogram_h__
+
+#include "base/def.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+namespace base
+{
+    struct HistogramSnapshot
+    {
+        HistogramSnapshot();
+
+        double    Mean() const;
+
+        // Approximate value below which |percent| of the samples fall,
+        // within the 12.5% width of a bucket.
+        long long Percentile(double percent) const;
+
+        long long              count;
+        long long              sum;
+        long long              max;
+        std::vector<long long> buckets;
+    };
+
+    /*
+     * Log-linear histogram of non-negative 64-bit values. Every power of
+     * two is split into 8 linear buckets, so the relative error stays
+     * under 12.5% from nanoseconds to hours. Add() is a few relaxed
+     * atomic increments and never locks; Snapshot() may run on any
+     * thread and sees each counter, not the whole, consistently.
+     */
+    class Histogram
+    {
+    public:
+        Histogram();
+
+        void Add(long long value);
+        void Snapshot(HistogramSnapshot* snapshot) const;
+
+        static const int kSubBucketBits = 3;
+        static const int kSubBuckets = 1 << kSubBucketBits;
+        static const int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+        static int       BucketOf(unsigned long long value);
+        static long long BucketLowerBound(int bucket);
+
+    private:
+        std::atomic<long long> counts_[kBuckets];
+        std::atomic<long long> count_;
+        std::atomic<long long> sum_;
+        std::atomic<long long> max_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(Histogram)
+    };
+}
+
+#endif
@@ -0,0 +1,302 @@
+#include "keyed_worker_pool.h"
+
+#include <stdint.h>
+
+namespace base
+{
+    static const unsigned long long kOutstandingMask = 0xffffffffULL;
+
+    static unsigned long long MakeBucketState(int worker, unsigned long long outstanding)
+    {
+        return ((unsigned long long)worker << 32) | outstanding;
+    }
+
+    static int WorkerOfState(unsigned long long state)
+    {
+        return (int)(state >> 32);
+    }
+
+    /*
+     * Holds its bucket while outstanding: from the post until the task
+     * has run, or was cancelled or discarded, when the slot deletes it.
+     */
+    class KeyedWorkerPool::KeyedTask : public Task
+    {
+    public:
+        KeyedTask(Bucket* bucket, Task* task)
+            : bucket_(bucket), task_(task)
+        {
+        }
+
+        virtual ~KeyedTask()
+        {
+            delete task_;
+            ReleaseBucket(bucket_);
+        }
+
+        virtual void Run()
+        {
+            task_->Run();
+        }
+
+        // a failed post hands the task back to the caller
+        Task* Unwrap()
+        {
+            Task* task = task_;
+            task_ = 0;
+            return task;
+        }
+
+    private:
+        Bucket* bucket_;
+        Task*   task_;
+    };
+
+    KeyedWorkerPool::KeyedWorkerPool(int num_workers)
+        : next_worker_(0)
+        , rebalance_(false)
+        , rebalance_ratio_(0)
+        , rebalance_min_depth_(0)
+        , posted_(false)
+        , quit_(false)
+        , code_(0)
+    {
+        if (num_workers <= 0)
+            num_workers = (int)std::thread::hardware_concurrency();
+        if (num_workers <= 0)
+            num_workers = 1;
+
+        for (int i = 0; i < kBuckets; ++i)
+            buckets_[i].state.store(MakeBucketState(i % num_workers, 0), std::memory_order_relaxed);
+
+        for (int i = 0; i < num_workers; ++i)
+            workers_.push_back(new Worker);
+
+        for (int i = 0; i < num_workers; ++i)
+        {
+            Center* center = &workers_[i]->center;
+            workers_[i]->thread = std::thread([center]() { center->Run(); });
+        }
+    }
+
+    KeyedWorkerPool::~KeyedWorkerPool()
+    {
+        Quit(0);
+        JoinWorkers();
+
+        // the centers discard what is left, releasing buckets as they go
+        for (size_t i = 0; i < workers_.size(); ++i)
+            delete workers_[i];
+    }
+
+    int KeyedWorkerPool::Run()
+    {
+        JoinWorkers();
+        return code_;
+    }
+
+    bool KeyedWorkerPool::Quit(int code)
+    {
+        if (quit_.exchange(true))
+            return true;
+
+        code_ = code;
+
+        // a center only quits once running, so the quit goes in as a
+        // task; it runs ahead of anything queued at lower priority
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            Center* center = &workers_[i]->center;
+            center->PostTask(NewCallableTask([center]() { center->Quit(0); }), PRIORITY_HIGHEST);
+        }
+
+        return true;
+    }
+
+    TaskHandle KeyedWorkerPool::PostTask(Task* task, TaskPriority priority)
+    {
+        if (!task)
+            return TaskHandle();
+
+        const void* key = task->AffinityKey();
+        if (!key)
+        {
+            if (quit_.load(std::memory_order_relaxed))
+                return TaskHandle();
+
+            return NextWorker()->center.PostTask(task, priority);
+        }
+
+        return PostTask(key, task, priority);
+    }
+
+    TaskHandle KeyedWorkerPool::PostTask(const void* key, Task* task, TaskPriority priority)
+    {
+        if (!task || quit_.load(std::memory_order_relaxed))
+            return TaskHandle();
+
+        MarkPosted();
+
+        Bucket* bucket = BucketOf(key);
+        if (!rebalance_)
+        {
+            int index = WorkerOfState(bucket->state.load(std::memory_order_relaxed));
+            return workers_[index]->center.PostTask(task, priority);
+        }
+
+        KeyedTask* keyed_task = new KeyedTask(bucket, task);
+        int index = AcquireBucket(bucket);
+        TaskHandle handle = workers_[index]->center.PostTask(keyed_task, priority);
+        if (!handle.IsValid())
+        {
+            keyed_task->Unwrap();
+            delete keyed_task;
+        }
+
+        return handle;
+    }
+
+    TaskHandle KeyedWorkerPool::PostDelayTask(const void* key, Task* task, const TimeDelta& delay)
+    {
+        if (!task || quit_.load(std::memory_order_relaxed))
+            return TaskHandle();
+
+        MarkPosted();
+
+        // a waiting delayed task keeps its bucket where it is
+        Bucket* bucket = BucketOf(key);
+        if (!rebalance_)
+        {
+            int index = WorkerOfState(bucket->state.load(std::memory_order_relaxed));
+            return workers_[index]->center.PostDelayTask(task, delay);
+        }
+
+        KeyedTask* keyed_task = new KeyedTask(bucket, task);
+        int index = AcquireBucket(bucket);
+        TaskHandle handle = workers_[index]->center.PostDelayTask(keyed_task, delay);
+        if (!handle.IsValid())
+        {
+            keyed_task->Unwrap();
+            delete keyed_task;
+        }
+
+        return handle;
+    }
+
+    bool KeyedWorkerPool::EnableRebalancing(double ratio, long min_depth)
+    {
+        if (posted_.load() || ratio <= 1.0)
+            return false;
+
+        rebalance_ = true;
+        rebalance_ratio_ = ratio;
+        rebalance_min_depth_ = min_depth;
+        return true;
+    }
+
+    int KeyedWorkerPool::WorkerCount() const
+    {
+        return (int)workers_.size();
+    }
+
+    int KeyedWorkerPool::WorkerOf(const void* key) const
+    {
+        return WorkerOfState(BucketOf(key)->state.load(std::memory_order_relaxed));
+    }
+
+    KeyedWorkerPool::Bucket* KeyedWorkerPool::BucketOf(const void* key) const
+    {
+        // Fibonacci hashing; the top bits mix in every bit of the key,
+        // the alignment zeros of a pointer included
+        unsigned long long hash = (unsigned long long)(uintptr_t)key * 0x9e3779b97f4a7c15ULL;
+        return const_cast<Bucket*>(&buckets_[hash >> (64 - kBucketBits)]);
+    }
+
+    int KeyedWorkerPool::AcquireBucket(Bucket* bucket)
+    {
+        // Acquire pairs with the release in ReleaseBucket, so a worker
+        // taking a bucket over sees everything its last task did.
+        unsigned long long state = bucket->state.load(std::memory_order_relaxed);
+        while (true)
+        {
+            unsigned long long next = state + 1;
+            if ((state & kOutstandingMask) == 0 && IsOverloaded(WorkerOfState(state)))
+                next = MakeBucketState(FindLeastLoadedWorker(), 1);
+
+            if (bucket->state.compare_exchange_weak(state, next, std::memory_order_acquire,
+                                                    std::memory_order_relaxed))
+                return WorkerOfState(next);
+        }
+    }
+
+    void KeyedWorkerPool::ReleaseBucket(Bucket* bucket)
+    {
+        bucket->state.fetch_sub(1, std::memory_order_release);
+    }
+
+    bool KeyedWorkerPool::IsOverloaded(int index) const
+    {
+        long depth = WorkerDepth(index);
+        if (depth < rebalance_min_depth_ || depth == 0)
+            return false;
+
+        long total = 0;
+        for (size_t i = 0; i < workers_.size(); ++i)
+            total += WorkerDepth((int)i);
+
+        return (double)depth * workers_.size() > rebalance_ratio_ * total;
+    }
+
+    int KeyedWorkerPool::FindLeastLoadedWorker() const
+    {
+        int least = 0;
+        long least_depth = WorkerDepth(0);
+        for (size_t i = 1; i < workers_.size() && least_depth > 0; ++i)
+        {
+            long depth = WorkerDepth((int)i);
+            if (depth < least_depth)
+            {
+                least = (int)i;
+                least_depth = depth;
+            }
+        }
+
+        return least;
+    }
+
+    long KeyedWorkerPool::WorkerDepth(int index) const
+    {
+        const Center& center = workers_[index]->center;
+
+        long depth = 0;
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+            depth += center.GetQueueDepth((TaskPriority)i);
+
+        return depth;
+    }
+
+    KeyedWorkerPool::Worker* KeyedWorkerPool::NextWorker()
+    {
+        unsigned int index = next_worker_.fetch_add(1, std::memory_order_relaxed);
+        return workers_[index % workers_.size()];
+    }
+
+    void KeyedWorkerPool::MarkPosted()
+    {
+        // read first, so later posts share the line instead of writing it
+        if (!posted_.load(std::memory_order_relaxed))
+            posted_.store(true, std::memory_order_relaxed);
+    }
+
+    void KeyedWorkerPool::JoinWorkers()
+    {
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            if (workers_[i]->thread.joinable() &&
+                workers_[i]->thread.get_id() != std::this_thread::get_id())
+            {
+                workers_[i]->thread.join();
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef __base_keyed_worker_pool_h__
+#define __base_keyed_worker_pool_h__
+
+#include "base/def.h"
+#include "base/task.h"
+#include "base/task_center.hpp"
+#include "base/task_handle.h"
+#include "base/time_ticks.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace base
+{
+    /*
+     * Runs tasks on N worker threads, each draining a TaskCenter of its
+     * own, and routes every task by a key: tasks posted under one key
+     * run on one worker, one at a time and, at one priority, in posting
+     * order. An object whose tasks all go under its key is only touched
+     * by that worker, so it needs no lock and its state stays in one
+     * core's cache. Keys hash to kBuckets buckets and buckets map to
+     * workers. With rebalancing on, a bucket leaves a worker whose queue
+     * has grown past its share, but only when its next task is posted
+     * while none of its tasks is outstanding, so a key never runs on two
+     * workers at once. Workers start with the pool, and Run() only
+     * blocks the caller until Quit().
+     */
+    class KeyedWorkerPool
+    {
+    public:
+        // 0 workers means one per hardware thread
+        explicit KeyedWorkerPool(int num_workers = 0);
+        ~KeyedWorkerPool();
+
+        int  Run();
+        bool Quit(int code);
+
+        // Keyed by the task's AffinityKey(), the target object of a
+        // MethodTask; a task without one goes to the workers in turn.
+        TaskHandle PostTask(Task* task, TaskPriority priority = PRIORITY_NORMAL);
+        TaskHandle PostTask(const void* key, Task* task, TaskPriority priority = PRIORITY_NORMAL);
+        TaskHandle PostDelayTask(const void* key, Task* task, const TimeDelta& delay);
+
+        // Moves keys off a worker once its queue holds at least min_depth
+        // tasks and more than ratio times the average. Every keyed post
+        // then pays a wrapper task and two atomic operations to track
+        // what is outstanding. Only before the first post.
+        bool EnableRebalancing(double ratio, long min_depth);
+
+        int WorkerCount() const;
+
+        // the worker the key's next task goes to, unless it moves
+        int WorkerOf(const void* key) const;
+
+    private:
+        typedef TaskCenter<FutexPump> Center;
+
+        class KeyedTask;
+
+        struct Worker
+        {
+            Center      center;
+            std::thread thread;
+        };
+
+        static const int kCacheLineSize = 64;
+        static const int kBucketBits = 8;
+        static const int kBuckets = 1 << kBucketBits;
+
+        // the worker in the high half, outstanding tasks in the low half
+        struct Bucket
+        {
+            std::atomic<unsigned long long> state;
+            char                            pad_[kCacheLineSize - sizeof(std::atomic<unsigned long long>)];
+        };
+
+        Bucket* BucketOf(const void* key) const;
+        int     AcquireBucket(Bucket* bucket);
+        bool    IsOverloaded(int index) const;
+        int     FindLeastLoadedWorker() const;
+        long    WorkerDepth(int index) const;
+        Worker* NextWorker();
+        void    MarkPosted();
+        void    JoinWorkers();
+
+        static void ReleaseBucket(Bucket* bucket);
+
+    private:
+        Bucket                    buckets_[kBuckets];
+        std::vector<Worker*>      workers_;
+        std::atomic<unsigned int> next_worker_;
+
+        bool                      rebalance_;
+        double                    rebalance_ratio_;
+        long                      rebalance_min_depth_;
+        std::atomic<bool>         posted_;
+
+        std::atomic<bool>         quit_;
+        int                       code_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(KeyedWorkerPool)
+    };
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __base_local_task_queue_h__
+#define __base_local_task_queue_h__
+
+#include "base/def.h"
+#include "base/task.h"
+
+namespace base
+{
+    /*
+     * Intrusive FIFO of Task touched by one thread only, the queue of a
+     * thread-confined TaskCenter. Same interface as MpscTaskQueue, but
+     * Push and Pop are a few plain loads and stores.
+     */
+    class LocalTaskQueue
+    {
+    public:
+        LocalTaskQueue()
+            : head_(0), tail_(0)
+        {
+        }
+
+        void Push(Task* task)
+        {
+            task->next_task_.store(0, std::memory_order_relaxed);
+            if (tail_)
+                tail_->next_task_.store(task, std::memory_order_relaxed);
+            else
+                head_ = task;
+
+            tail_ = task;
+        }
+
+        Task* Pop()
+        {
+            Task* task = head_;
+            if (!task)
+                return 0;
+
+            head_ = task->next_task_.load(std::memory_order_relaxed);
+            if (!head_)
+                tail_ = 0;
+
+            return task;
+        }
+
+        bool Empty() const
+        {
+            return head_ == 0;
+        }
+
+    private:
+        Task* head_;
+        Task* tail_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(LocalTaskQueue)
+    };
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __base_location_h__
+#define __base_location_h__
+
+namespace base
+{
+    // Where a task was posted from, see FROM_HERE.
+    struct Location
+    {
+        Location()
+            : file(0), line(0) {}
+
+        Location(const char* file, int line)
+            : file(file), line(line) {}
+
+        bool is_null() const
+        {
+            return file == 0;
+        }
+
+        const char* file;
+        int         line;
+    };
+}
+
+#define FROM_HERE base::Location(__FILE__, __LINE__)
+
+#endif
@@ -1,7 +1,15 @@
 #include "locker.h"
+#include "futex.h"
+
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <sched.h>
+#endif
 
 namespace base
 {
+#if defined(_WIN32)
     CSLocker::CSLocker()
     {
         ::InitializeCriticalSection(&critical_section_);
@@ -21,21 +29,295 @@ namespace base
     {
         ::LeaveCriticalSection(&critical_section_);
     }
+#else
+    CSLocker::CSLocker()
+    {
+        ::pthread_mutex_init(&mutex_, 0);
+    }
+
+    CSLocker::~CSLocker()
+    {
+        ::pthread_mutex_destroy(&mutex_);
+    }
+
+    void CSLocker::Lock()
+    {
+        ::pthread_mutex_lock(&mutex_);
+    }
+
+    void CSLocker::Unlock()
+    {
+        ::pthread_mutex_unlock(&mutex_);
+    }
+#endif
+
+
+    static inline void YieldThread()
+    {
+#if defined(_WIN32)
+        ::SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
 
+    // pauses for the first spins of a wait, then gives the core away
+    static inline void SpinOnce(int* spins)
+    {
+        static const int kSpinsBeforeYield = 64;
+
+        if (*spins < kSpinsBeforeYield)
+        {
+            ++*spins;
+            CpuRelax();
+        }
+        else
+        {
+            YieldThread();
+        }
+    }
 
     CSpinLock::CSpinLock()
-        : locked_(0L) {}
+        : state_(UNLOCKED) {}
 
     CSpinLock::~CSpinLock() {}
 
-    void CSpinLock::Lock()
+    bool CSpinLock::TryLock()
+    {
+        int expected = UNLOCKED;
+        return state_.load(std::memory_order_relaxed) == UNLOCKED &&
+               state_.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
+    }
+
+    void CSpinLock::LockSlow()
+    {
+        int backoff = 1;
+        for (int round = 0; round < kSpinRounds; ++round)
+        {
+            // only try the write once a read says the lock is free
+            if (state_.load(std::memory_order_relaxed) == UNLOCKED)
+            {
+                int expected = UNLOCKED;
+                if (state_.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire))
+                    return;
+            }
+
+            for (int i = 0; i < backoff; ++i)
+                CpuRelax();
+
+            if (backoff < kMaxBackoff)
+                backoff <<= 1;
+        }
+
+        // A lock taken here stays marked contended, which costs its owner
+        // one needless wake when no one else is waiting.
+        while (state_.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED)
+            Wait();
+    }
+
+    void CSpinLock::Wait()
+    {
+        FutexWait(&state_, CONTENDED);
+    }
+
+    void CSpinLock::WakeOne()
+    {
+        FutexWakeOne(&state_);
+    }
+
+
+    CTicketLock::CTicketLock()
+        : next_ticket_(0)
+        , now_serving_(0) {}
+
+    CTicketLock::~CTicketLock() {}
+
+    void CTicketLock::Lock()
+    {
+        static const int kBackoffPerWaiter = 16;
+
+        unsigned int ticket = next_ticket_.fetch_add(1, std::memory_order_relaxed);
+        int pauses = 0;
+        while (true)
+        {
+            unsigned int serving = now_serving_.load(std::memory_order_acquire);
+            if (serving == ticket)
+                return;
+
+            // The further back in line, the longer the next look can wait.
+            // Past the budget the holder, or whoever is next, is probably
+            // not running, so let it have the core.
+            if (pauses < kSpinBudget)
+            {
+                int backoff = (int)(ticket - serving) * kBackoffPerWaiter;
+                for (int i = 0; i < backoff; ++i)
+                    CpuRelax();
+                pauses += backoff;
+            }
+            else
+            {
+                YieldThread();
+            }
+        }
+    }
+
+    bool CTicketLock::TryLock()
+    {
+        unsigned int serving = now_serving_.load(std::memory_order_acquire);
+        unsigned int expected = serving;
+        return next_ticket_.compare_exchange_strong(expected, serving + 1, std::memory_order_acquire);
+    }
+
+    void CTicketLock::Unlock()
+    {
+        // only the holder writes now_serving_
+        now_serving_.store(now_serving_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+
+    THREAD_LOCAL CMcsLock::NodeStack* CMcsLock::node_stack_ = 0;
+
+    CMcsLock::CMcsLock()
+        : tail_(0)
+        , holder_(0) {}
+
+    CMcsLock::~CMcsLock() {}
+
+    void CMcsLock::Lock()
+    {
+        Node* node = PushNode();
+        node->next.store(0, std::memory_order_relaxed);
+        node->locked.store(1, std::memory_order_relaxed);
+
+        Node* prev = tail_.exchange(node, std::memory_order_acq_rel);
+        if (prev)
+        {
+            prev->next.store(node, std::memory_order_release);
+
+            int spins = 0;
+            while (node->locked.load(std::memory_order_acquire))
+                SpinOnce(&spins);
+        }
+
+        holder_ = node;
+    }
+
+    void CMcsLock::Unlock()
+    {
+        Node* node = holder_;
+        Node* next = node->next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            Node* expected = node;
+            if (tail_.compare_exchange_strong(expected, 0, std::memory_order_acq_rel))
+            {
+                PopNode();
+                return;
+            }
+
+            // a successor swapped itself in but has not linked up yet
+            int spins = 0;
+            while (!(next = node->next.load(std::memory_order_acquire)))
+                SpinOnce(&spins);
+        }
+
+        next->locked.store(0, std::memory_order_release);
+        PopNode();
+    }
+
+    CMcsLock::Node* CMcsLock::PushNode()
+    {
+        // per-thread stacks live as long as the process
+        NodeStack* stack = node_stack_;
+        if (!stack)
+        {
+            stack = new NodeStack();
+            stack->depth = 0;
+            node_stack_ = stack;
+        }
+
+        // one more nested lock would write past the stack and corrupt
+        // whatever follows it, so stop here in release builds as well
+        BASE_DCHECK(stack->depth < kMaxNesting);
+        if (stack->depth >= kMaxNesting)
+            abort();
+
+        return &stack->nodes[stack->depth++];
+    }
+
+    void CMcsLock::PopNode()
+    {
+        BASE_DCHECK(node_stack_ && node_stack_->depth > 0);
+        --node_stack_->depth;
+    }
+
+
+    THREAD_LOCAL int CRWLock::shard_index_ = -1;
+
+    CRWLock::CRWLock()
+        : writer_(0)
+    {
+        for (int i = 0; i < kShards; ++i)
+            shards_[i].readers.store(0, std::memory_order_relaxed);
+    }
+
+    CRWLock::~CRWLock() {}
+
+    void CRWLock::Lock()
+    {
+        writer_locker_.Lock();
+        writer_.store(1, std::memory_order_seq_cst);
+
+        for (int i = 0; i < kShards; ++i)
+        {
+            int spins = 0;
+            while (shards_[i].readers.load(std::memory_order_seq_cst) != 0)
+                SpinOnce(&spins);
+        }
+    }
+
+    void CRWLock::Unlock()
+    {
+        writer_.store(0, std::memory_order_release);
+        writer_locker_.Unlock();
+    }
+
+    void CRWLock::LockShared()
+    {
+        // a reader announces itself before it looks for a writer, and a
+        // writer the other way round, so the two cannot both go ahead
+        Shard& shard = shards_[ShardIndex()];
+        while (true)
+        {
+            shard.readers.fetch_add(1, std::memory_order_seq_cst);
+            if (!writer_.load(std::memory_order_seq_cst))
+                return;
+
+            shard.readers.fetch_sub(1, std::memory_order_release);
+
+            int spins = 0;
+            while (writer_.load(std::memory_order_acquire))
+                SpinOnce(&spins);
+        }
+    }
+
+    void CRWLock::UnlockShared()
     {
-        while (InterlockedExchange(&locked_, 1L) == 1L)
-            Sleep(0);
+        shards_[ShardIndex()].readers.fetch_sub(1, std::memory_order_release);
     }
 
-    void CSpinLock::Unlock()
+    int CRWLock::ShardIndex()
     {
-        InterlockedExchange(&locked_, 0L);
+        // threads are dealt shards round-robin the first time they read
+        static std::atomic<int> next_shard(0);
+
+        int index = shard_index_;
+        if (index < 0)
+        {
+            index = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+            shard_index_ = index;
+        }
+
+        return index;
     }
-}
\ No newline at end of file
+}
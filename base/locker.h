@@ -1,10 +1,30 @@
 #ifndef __base_locker_h__
 #define __base_locker_h__
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "base/def.h"
+
+#include <atomic>
 
 namespace base
 {
+    // a spin-wait hint to the CPU
+    inline void CpuRelax()
+    {
+#if defined(_MSC_VER)
+        YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
     /*
      * locks
      */
@@ -18,20 +38,178 @@ namespace base
         void Unlock();
 
     private:
+#if defined(_WIN32)
         CRITICAL_SECTION critical_section_;
+#else
+        pthread_mutex_t mutex_;
+#endif
     };
 
-    class CSpinLock
+    /*
+     * Test-and-test-and-set spin lock. Waiters spin on a plain load with
+     * a CPU pause and exponential backoff, so the line stays shared until
+     * the lock looks free, and after a short spin budget sleep on the
+     * lock word (futex on Linux, WaitOnAddress on Windows 8+) instead of
+     * burning the core. The lock fills a cache line of its own and is
+     * aligned to one, so no neighbour shares it wherever it is placed.
+     */
+    class BASE_ALIGNAS(64) CSpinLock
     {
     public:
         CSpinLock();
         ~CSpinLock();
 
+        // the uncontended paths are inline, one atomic each
+        void Lock()
+        {
+            int expected = UNLOCKED;
+            if (!state_.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire))
+                LockSlow();
+        }
+
+        void Unlock()
+        {
+            if (state_.exchange(UNLOCKED, std::memory_order_release) == CONTENDED)
+                WakeOne();
+        }
+
+        bool TryLock();
+
+    private:
+        enum
+        {
+            UNLOCKED  = 0,
+            LOCKED    = 1,
+            CONTENDED = 2   // locked, and a waiter may be asleep
+        };
+
+        static const int kCacheLineSize = 64;
+        static const int kSpinRounds = 10;
+        static const int kMaxBackoff = 32;
+
+        void LockSlow();
+        void Wait();
+        void WakeOne();
+
+    private:
+        std::atomic<int> state_;
+        char             pad_[kCacheLineSize - sizeof(std::atomic<int>)];
+
+    private:
+        CSpinLock(const CSpinLock&);
+        void operator=(const CSpinLock&);
+    };
+
+    /*
+     * FIFO spin lock: a waiter takes a ticket and spins until it is
+     * served, backing off in proportion to its place in the line, so the
+     * lock is handed out in arrival order.
+     */
+    class CTicketLock
+    {
+    public:
+        CTicketLock();
+        ~CTicketLock();
+
+        void Lock();
+        bool TryLock();
+        void Unlock();
+
+    private:
+        static const int kSpinBudget = 128;
+
+        std::atomic<unsigned int> next_ticket_;
+        std::atomic<unsigned int> now_serving_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(CTicketLock)
+    };
+
+    /*
+     * MCS queue lock. Every waiter spins on its own queue node instead
+     * of the shared lock word, so a handover touches one remote line
+     * however many threads wait, and the order is FIFO. Nodes come from
+     * a small per-thread stack: MCS locks held at the same time by one
+     * thread must be released in reverse order, at most kMaxNesting deep.
+     */
+    class CMcsLock
+    {
+    public:
+        CMcsLock();
+        ~CMcsLock();
+
+        void Lock();
+        void Unlock();
+
+        static const int kMaxNesting = 8;
+
+    private:
+        struct Node
+        {
+            std::atomic<Node*> next;
+            std::atomic<int>   locked;
+        };
+
+        struct NodeStack
+        {
+            Node nodes[kMaxNesting];
+            int  depth;
+        };
+
+        static Node* PushNode();
+        static void  PopNode();
+
+    private:
+        std::atomic<Node*> tail_;
+        Node*              holder_;
+
+        static THREAD_LOCAL NodeStack* node_stack_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(CMcsLock)
+    };
+
+    /*
+     * Reader-writer lock for read-mostly data. Readers count themselves
+     * on one of kShards cache-line sized counters picked per thread, so
+     * readers on different cores never write the same line. A writer
+     * raises a flag, which turns new readers away, and waits for every
+     * shard to drain; writers exclude each other with a CSLocker.
+     */
+    class CRWLock
+    {
+    public:
+        CRWLock();
+        ~CRWLock();
+
         void Lock();
         void Unlock();
 
+        void LockShared();
+        void UnlockShared();
+
+        static const int kShards = 16;
+
     private:
-        LONG locked_;
+        static const int kCacheLineSize = 64;
+
+        struct Shard
+        {
+            std::atomic<int> readers;
+            char             pad[kCacheLineSize - sizeof(std::atomic<int>)];
+        };
+
+        static int ShardIndex();
+
+    private:
+        Shard            shards_[kShards];
+        std::atomic<int> writer_;
+        CSLocker         writer_locker_;
+
+        static THREAD_LOCAL int shard_index_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(CRWLock)
     };
 
 
@@ -52,6 +230,17 @@ namespace base
             locker_.Unlock();
         }
 
+        // for lockers with a shared mode, such as CRWLock
+        void AcquireShared()
+        {
+            locker_.LockShared();
+        }
+
+        void ReleaseShared()
+        {
+            locker_.UnlockShared();
+        }
+
     private:
         Locker locker_;
     };
@@ -62,6 +251,8 @@ namespace base
     public:
         void Acquire() {}
         void Release() {}
+        void AcquireShared() {}
+        void ReleaseShared() {}
     };
 
 
@@ -88,6 +279,26 @@ namespace base
         Guard<Locker>* guard_;
     };
 
+    template<typename Locker,
+             template <typename> class Guard = MultiThreadGuard>
+    class AutoSharedLocker
+    {
+    public:
+        AutoSharedLocker(Guard<Locker>* guard)
+            : guard_(guard)
+        {
+            guard_->AcquireShared();
+        }
+
+        ~AutoSharedLocker()
+        {
+            guard_->ReleaseShared();
+        }
+
+    private:
+        Guard<Locker>* guard_;
+    };
+
     template<typename Locker,
              template <typename> class Guard = MultiThreadGuard>
     class AutoUnlocker
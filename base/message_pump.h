@@ -4,6 +4,8 @@
 #include <windows.h>
 
 #include "def.h"
+#include "locker.h"
+#include "time_ticks.h"
 
 namespace base
 {
@@ -17,7 +19,10 @@ namespace base
         int  Run(Processor* processor);
         void Quit(int code);
         bool ScheduleTask();
-        bool ScheduleDelayTask(int next_delay_time);
+        bool ScheduleDelayTask(const TimeTicks& delayed_run_time);
+
+        // ScheduleTask from the pump's own thread, inside a callback
+        bool ScheduleLocalTask();
 
     private:
         static LRESULT CALLBACK WndProcThunk(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam);
@@ -45,10 +50,11 @@ namespace base
             int code;
         };
 
-        RunState state_;
-        HWND     message_hwnd_;
-        LONG     have_task_;
-        LONG     have_delay_task_;
+        RunState                   state_;
+        HWND                       message_hwnd_;
+        LONG                       have_task_;
+        MultiThreadGuard<CSLocker> timer_locker_;
+        TimeTicks                  delayed_run_time_;
 
     private:
         DISABLE_COPY_AND_ASSIGN(MessagePump)
@@ -12,7 +12,6 @@ namespace base
     template<typename Processor>
     MessagePump<Processor>::MessagePump()
         : have_task_(0L)
-        , have_delay_task_(0L)
     {
         InitMessageWnd();
     }
@@ -54,14 +53,33 @@ namespace base
     }
 
     template<typename Processor>
-    bool MessagePump<Processor>::ScheduleDelayTask(int time)
+    bool MessagePump<Processor>::ScheduleLocalTask()
     {
-        if (InterlockedExchange(&have_delay_task_, 1L))
+        // A window procedure may be inside a modal loop that never returns
+        // to RunLoop, so the message is posted all the same; have_task_
+        // keeps it to one per drain.
+        return ScheduleTask();
+    }
+
+    template<typename Processor>
+    bool MessagePump<Processor>::ScheduleDelayTask(const TimeTicks& delayed_run_time)
+    {
+        AutoLocker<CSLocker> guard(&timer_locker_);
+        if (!delayed_run_time_.is_null() && delayed_run_time_ <= delayed_run_time)
         {
             return false;
         }
 
-        SetTimer(message_hwnd_, reinterpret_cast<UINT_PTR>(this), time, NULL);
+        delayed_run_time_ = delayed_run_time;
+
+        // SetTimer only counts milliseconds, round up so it never fires early
+        long long delay = (delayed_run_time - TimeTicks::Now()).InMillisecondsRoundedUp();
+        if (delay < 0)
+        {
+            delay = 0;
+        }
+
+        SetTimer(message_hwnd_, reinterpret_cast<UINT_PTR>(this), (UINT)delay, NULL);
         return true;
     }
 
@@ -202,11 +220,13 @@ namespace base
     template<typename Processor>
     void MessagePump<Processor>::WillProcessMessage(const MSG& msg)
     {
+        state_.processor->WillProcessMessage();
     }
 
     template<typename Processor>
     void MessagePump<Processor>::DidProcessMessage(const MSG& msg)
     {
+        state_.processor->DidProcessMessage();
     }
 
     template<typename Processor>
@@ -223,13 +243,16 @@ namespace base
     void MessagePump<Processor>::HandleTimerMessage()
     {
         KillTimer(message_hwnd_, reinterpret_cast<UINT_PTR>(this));
-        InterlockedExchange(&have_delay_task_, 0L);
+        {
+            AutoLocker<CSLocker> guard(&timer_locker_);
+            delayed_run_time_ = TimeTicks();
+        }
 
-        int delay_time = 0;
-        bool more_delay_work = state_.processor->DoDelayTask(&delay_time);
+        TimeTicks delayed_run_time;
+        bool more_delay_work = state_.processor->DoDelayTask(&delayed_run_time);
         if (more_delay_work)
         {
-            ScheduleDelayTask(delay_time);
+            ScheduleDelayTask(delayed_run_time);
         }
     }
 }
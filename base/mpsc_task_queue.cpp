@@ -0,0 +1,66 @@
+#include "mpsc_task_queue.h"
+
+namespace base
+{
+    MpscTaskQueue::MpscTaskQueue()
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+        stub_.next_task_.store(0, std::memory_order_relaxed);
+    }
+
+    MpscTaskQueue::~MpscTaskQueue() {}
+
+    void MpscTaskQueue::Push(Task* task)
+    {
+        task->next_task_.store(0, std::memory_order_relaxed);
+        Task* prev = head_.exchange(task, std::memory_order_acq_rel);
+        prev->next_task_.store(task, std::memory_order_release);
+    }
+
+    Task* MpscTaskQueue::Pop()
+    {
+        Task* tail = tail_;
+        Task* next = tail->next_task_.load(std::memory_order_acquire);
+
+        if (tail == &stub_)
+        {
+            if (!next)
+                return 0;
+
+            tail_ = next;
+            tail = next;
+            next = next->next_task_.load(std::memory_order_acquire);
+        }
+
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+
+        // tail is the last linked node, a producer may still be linking
+        if (tail != head_.load(std::memory_order_acquire))
+            return 0;
+
+        Push(&stub_);
+
+        next = tail->next_task_.load(std::memory_order_acquire);
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+
+        return 0;
+    }
+
+    bool MpscTaskQueue::Empty() const
+    {
+        Task* tail = tail_;
+        if (tail != &stub_)
+            return false;
+
+        return stub_.next_task_.load(std::memory_order_acquire) == 0;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef __base_mpsc_task_queue_h__
+#define __base_mpsc_task_queue_h__
+
+#include "base/def.h"
+#include "base/task.h"
+
+#include <atomic>
+
+namespace base
+{
+    /*
+     * Intrusive multi-producer/single-consumer queue of Task (Vyukov).
+     * Push is one atomic exchange plus one store and may be called from
+     * any thread; Pop and Empty belong to the single consumer thread.
+     * Pop can return 0 while a producer is between its two steps, that
+     * producer schedules the pump right after, so nothing is lost.
+     */
+    class MpscTaskQueue
+    {
+    public:
+        MpscTaskQueue();
+        ~MpscTaskQueue();
+
+        void  Push(Task* task);
+        Task* Pop();
+        bool  Empty() const;
+
+    private:
+        class StubTask : public Task
+        {
+        public:
+            virtual void Run() {}
+        };
+
+        static const int kCacheLineSize = 64;
+
+        std::atomic<Task*> head_;
+        char               pad_[kCacheLineSize - sizeof(std::atomic<Task*>)];
+        Task*              tail_;
+        StubTask           stub_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(MpscTaskQueue)
+    };
+}
+
+#endif
@@ -0,0 +1,156 @@
+#include "base/sequenced_task_runner.h"
+
+namespace base
+{
+    THREAD_LOCAL const SequencedTaskRunner* SequencedTaskRunner::current_sequence_ = 0;
+
+    class SequencedTaskRunner::RunSequenceTask : public Task
+    {
+    public:
+        explicit RunSequenceTask(SequencedTaskRunner* runner)
+            : runner_(runner) {}
+
+        virtual void Run()
+        {
+            runner_->RunSequence();
+        }
+
+    private:
+        SequencedTaskRunner* runner_;
+    };
+
+    // Holds a delayed task in the pool until it is due, then moves it to
+    // the back of the sequence. Dropped by the pool, it discards the task.
+    class SequencedTaskRunner::DelayedEnqueueTask : public Task
+    {
+    public:
+        DelayedEnqueueTask(SequencedTaskRunner* runner, Task* slot_task)
+            : runner_(runner), slot_task_(slot_task) {}
+
+        virtual ~DelayedEnqueueTask()
+        {
+            if (slot_task_)
+                TaskSlotTable::Discard(slot_task_);
+        }
+
+        virtual void Run()
+        {
+            Task* slot_task = slot_task_;
+            slot_task_ = 0;
+            runner_->Enqueue(slot_task);
+        }
+
+    private:
+        SequencedTaskRunner* runner_;
+        Task*                slot_task_;
+    };
+
+    SequencedTaskRunner::SequencedTaskRunner(WorkerPool* pool)
+        : pool_(pool)
+        , pending_(0) {}
+
+    SequencedTaskRunner::~SequencedTaskRunner()
+    {
+        while (Task* task = task_queue_.Pop())
+        {
+            TaskSlotTable::Discard(task);
+        }
+    }
+
+    TaskHandle SequencedTaskRunner::PostTask(Task* task)
+    {
+        TaskHandle handle;
+        if (!task || !pool_)
+            return handle;
+
+        Task* slot_task = task_slots_.Wrap(task, &handle);
+        if (!slot_task)
+            return handle;
+
+        Enqueue(slot_task);
+        return handle;
+    }
+
+    TaskHandle SequencedTaskRunner::PostDelayTask(Task* task, int delay_time)
+    {
+        return PostDelayTask(task, TimeDelta::FromMilliseconds(delay_time));
+    }
+
+    TaskHandle SequencedTaskRunner::PostDelayTask(Task* task, const TimeDelta& delay)
+    {
+        TaskHandle handle;
+        if (!task || !pool_)
+            return handle;
+
+        Task* slot_task = task_slots_.Wrap(task, &handle);
+        if (!slot_task)
+            return handle;
+
+        Task* forwarder = new DelayedEnqueueTask(this, slot_task);
+        if (!pool_->PostDelayTask(forwarder, delay))
+        {
+            // deleting the forwarder discards the wrapped task as well
+            delete forwarder;
+            return TaskHandle();
+        }
+
+        return handle;
+    }
+
+    bool SequencedTaskRunner::RunsTasksInCurrentSequence() const
+    {
+        return current_sequence_ == this;
+    }
+
+    void SequencedTaskRunner::Enqueue(Task* slot_task)
+    {
+        // Count before pushing, so pending_ never falls below what the
+        // running sequence can pop; the other order lets it go negative
+        // and schedules a second sequence alongside the first.
+        bool schedule = pending_.fetch_add(1, std::memory_order_acq_rel) == 0;
+        task_queue_.Push(slot_task);
+
+        // only the post that makes the sequence non-empty schedules it
+        if (schedule)
+        {
+            ScheduleSequence();
+        }
+    }
+
+    void SequencedTaskRunner::ScheduleSequence()
+    {
+        // once the pool has quit the sequence is never scheduled again, and
+        // whatever is queued is discarded with the runner
+        Task* task = new RunSequenceTask(this);
+        if (!pool_->PostTask(task))
+        {
+            delete task;
+        }
+    }
+
+    void SequencedTaskRunner::RunSequence()
+    {
+        const SequencedTaskRunner* outer = current_sequence_;
+        current_sequence_ = this;
+
+        long run_count = 0;
+        while (run_count < kTasksPerTurn)
+        {
+            // a producer between its exchange and link leaves the queue
+            // looking empty for a moment; the sequence just goes round again
+            Task* task = task_queue_.Pop();
+            if (!task)
+                break;
+
+            task->Run();
+            ++run_count;
+        }
+
+        current_sequence_ = outer;
+
+        if (pending_.fetch_sub(run_count, std::memory_order_acq_rel) != run_count)
+        {
+            ScheduleSequence();
+        }
+    }
+}
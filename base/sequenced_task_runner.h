@@ -0,0 +1,61 @@
+#ifndef __base_sequenced_task_runner_h__
+#define __base_sequenced_task_runner_h__
+
+#include "base/def.h"
+#include "base/mpsc_task_queue.h"
+#include "base/task.h"
+#include "base/task_handle.h"
+#include "base/time_ticks.h"
+#include "base/worker_pool.h"
+
+#include <atomic>
+
+namespace base
+{
+    /*
+     * A strand on a WorkerPool. Tasks posted to one runner run one at a
+     * time in posting order, each on whichever worker picks the sequence
+     * up, so a component gets TaskCenter-like serialisation without a
+     * thread of its own. The sequence is posted to the pool as a single
+     * task when it goes from empty to non-empty and reposts itself while
+     * it has work left. The runner must outlive the tasks it has posted,
+     * destroy it once the pool has quit or the sequence is drained.
+     */
+    class SequencedTaskRunner
+    {
+    public:
+        explicit SequencedTaskRunner(WorkerPool* pool);
+        ~SequencedTaskRunner();
+
+        TaskHandle PostTask(Task* task);
+        TaskHandle PostDelayTask(Task* task, int delay_time);
+        TaskHandle PostDelayTask(Task* task, const TimeDelta& delay);
+
+        // true inside a task running on this sequence
+        bool RunsTasksInCurrentSequence() const;
+
+    private:
+        class RunSequenceTask;
+        class DelayedEnqueueTask;
+
+        void Enqueue(Task* slot_task);
+        void RunSequence();
+        void ScheduleSequence();
+
+        // tasks run per pool task before the sequence yields its worker
+        static const int kTasksPerTurn = 16;
+
+    private:
+        WorkerPool*         pool_;
+        TaskSlotTable       task_slots_;
+        MpscTaskQueue       task_queue_;
+        std::atomic<long>   pending_;
+
+        static THREAD_LOCAL const SequencedTaskRunner* current_sequence_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(SequencedTaskRunner)
+    };
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "singleton.h"
+
+namespace base
+{
+    struct ThreadExitCallback
+    {
+        void              (*fn)(void*);
+        void*               arg;
+        ThreadExitCallback* next;
+    };
+
+    // The per-thread list hangs off one TLS slot whose destructor runs it.
+    // A callback that registers another (a thread-local singleton using
+    // one already destroyed) starts a new list, which the thread library
+    // runs in a later pass.
+    static void RunThreadExitCallbacks(void* head)
+    {
+        ThreadExitCallback* callback = static_cast<ThreadExitCallback*>(head);
+        while (callback)
+        {
+            ThreadExitCallback* next = callback->next;
+            callback->fn(callback->arg);
+            delete callback;
+            callback = next;
+        }
+    }
+
+#if defined(_WIN32)
+    static INIT_ONCE g_thread_exit_once = INIT_ONCE_STATIC_INIT;
+    static DWORD     g_thread_exit_slot = FLS_OUT_OF_INDEXES;
+
+    static void NTAPI OnFiberExit(void* head)
+    {
+        RunThreadExitCallbacks(head);
+    }
+
+    static BOOL CALLBACK CreateThreadExitSlot(PINIT_ONCE, void*, void**)
+    {
+        g_thread_exit_slot = ::FlsAlloc(OnFiberExit);
+        return TRUE;
+    }
+
+    void RegisterThreadExit(void (*fn)(void*), void* arg)
+    {
+        ::InitOnceExecuteOnce(&g_thread_exit_once, CreateThreadExitSlot, 0, 0);
+
+        ThreadExitCallback* callback = new ThreadExitCallback;
+        callback->fn = fn;
+        callback->arg = arg;
+        callback->next = static_cast<ThreadExitCallback*>(::FlsGetValue(g_thread_exit_slot));
+        ::FlsSetValue(g_thread_exit_slot, callback);
+    }
+#else
+    static pthread_once_t g_thread_exit_once = PTHREAD_ONCE_INIT;
+    static pthread_key_t  g_thread_exit_key;
+
+    static void CreateThreadExitKey()
+    {
+        ::pthread_key_create(&g_thread_exit_key, RunThreadExitCallbacks);
+    }
+
+    void RegisterThreadExit(void (*fn)(void*), void* arg)
+    {
+        ::pthread_once(&g_thread_exit_once, CreateThreadExitKey);
+
+        ThreadExitCallback* callback = new ThreadExitCallback;
+        callback->fn = fn;
+        callback->arg = arg;
+        callback->next = static_cast<ThreadExitCallback*>(::pthread_getspecific(g_thread_exit_key));
+        ::pthread_setspecific(g_thread_exit_key, callback);
+    }
+#endif
+}
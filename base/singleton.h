@@ -3,6 +3,9 @@
 
 #include "base/locker.h"
 
+#include <atomic>
+#include <stdlib.h>
+
 namespace base
 {
     template<typename T>
@@ -28,6 +31,29 @@ namespace base
     };
 
 
+    /*
+     * One instance per thread, created on the thread's first Instance()
+     * call and destroyed when that thread exits. Nothing is shared, so
+     * nothing is locked. The thread still running at process exit (the
+     * main thread, usually) leaks its instance, as with LeakySingletonTraits.
+     */
+    template<typename T>
+    struct ThreadLocalSingletonTraits: public DefaultSingletonTraits<T>
+    {
+        static const bool kRegisterAtExit = false;
+    };
+
+
+    // Runs fn(arg) when the calling thread exits, callbacks in reverse
+    // order of registration.
+    void RegisterThreadExit(void (*fn)(void*), void* arg);
+
+
+    /*
+     * Once the instance exists Instance() is one acquire load, a plain
+     * load on x86. Creation takes the lock and publishes the pointer with
+     * a release store, so no thread can see it before the constructor ran.
+     */
     template<typename T,
              typename SingletonTraits = DefaultSingletonTraits<T>,
              template<typename Locker> class Guard = MultiThreadGuard>
@@ -36,29 +62,36 @@ namespace base
     public:
         static T& Instance()
         {
-            if (!instance_)
+            T* instance = instance_.load(std::memory_order_acquire);
+            if (instance)
+                return *instance;
+
+            return *CreateInstance();
+        }
+
+    private:
+        static BASE_NOINLINE T* CreateInstance()
+        {
+            AutoLocker<CSLocker> guard(&locker_);
+            T* instance = instance_.load(std::memory_order_relaxed);
+            if (!instance)
             {
-                AutoLocker<CSLocker> guard(&locker_);
-                if (!instance_)
-                {
-                    instance_ = SingletonTraits::Create();
-                    if (instance_ && SingletonTraits::kRegisterAtExit)
-                        atexit(DestroySingleton);
-                }
+                instance = SingletonTraits::Create();
+                instance_.store(instance, std::memory_order_release);
+                if (instance && SingletonTraits::kRegisterAtExit)
+                    atexit(DestroySingleton);
             }
 
-            return *instance_;
+            return instance;
         }
 
-    private:
         static void DestroySingleton()
         {
-            SingletonTraits::Destroy(instance_);
-            instance_ = 0;
+            SingletonTraits::Destroy(instance_.exchange(0, std::memory_order_acq_rel));
         }
 
     private:
-        static T* instance_;
+        static std::atomic<T*> instance_;
         static Guard<CSLocker> locker_;
 
     private:
@@ -70,10 +103,54 @@ namespace base
     };
 
     template<typename T, typename SingletonTraits, template<typename Locker> class Guard>
-    T* Singleton<T, SingletonTraits, Guard>::instance_ = 0;
+    std::atomic<T*> Singleton<T, SingletonTraits, Guard>::instance_;
 
     template<typename T, typename SingletonTraits, template<typename Locker> class Guard>
     Guard<CSLocker> Singleton<T, SingletonTraits, Guard>::locker_;
+
+
+    template<typename T, template<typename Locker> class Guard>
+    class Singleton<T, ThreadLocalSingletonTraits<T>, Guard>
+    {
+    public:
+        static T& Instance()
+        {
+            T* instance = instance_;
+            if (instance)
+                return *instance;
+
+            return *CreateInstance();
+        }
+
+    private:
+        static BASE_NOINLINE T* CreateInstance()
+        {
+            instance_ = ThreadLocalSingletonTraits<T>::Create();
+            if (instance_)
+                RegisterThreadExit(DestroySingleton, instance_);
+
+            return instance_;
+        }
+
+        static void DestroySingleton(void* instance)
+        {
+            instance_ = 0;
+            ThreadLocalSingletonTraits<T>::Destroy(static_cast<T*>(instance));
+        }
+
+    private:
+        static THREAD_LOCAL T* instance_;
+
+    private:
+        Singleton(){}
+        ~Singleton(){}
+
+        Singleton(const Singleton&);
+        Singleton& operator=(const Singleton&);
+    };
+
+    template<typename T, template<typename Locker> class Guard>
+    THREAD_LOCAL T* Singleton<T, ThreadLocalSingletonTraits<T>, Guard>::instance_ = 0;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,8 +1,20 @@
 #include "task.h"
+#include "task_allocator.h"
 
 namespace base
 {
-    Task::Task() {}
+    Task::Task()
+        : next_task_(0) {}
 
     Task::~Task() {}
+
+    void* Task::operator new(size_t size)
+    {
+        return TaskAllocator::Alloc(size);
+    }
+
+    void Task::operator delete(void* ptr)
+    {
+        TaskAllocator::Free(ptr);
+    }
 }
\ No newline at end of file
@@ -1,10 +1,26 @@
 #ifndef __base_task_h__
 #define __base_task_h__
 
+#include "time_ticks.h"
 #include "tuple.h"
 
+#include <atomic>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
 namespace base
 {
+    // Levels a task can be posted at, most urgent first.
+    enum TaskPriority
+    {
+        PRIORITY_HIGHEST       = 0,
+        PRIORITY_USER_BLOCKING = 1,
+        PRIORITY_NORMAL        = 2,
+        PRIORITY_BEST_EFFORT   = 3,
+        PRIORITY_COUNT         = 4
+    };
+
     class Task
     {
     public:
@@ -12,6 +28,50 @@ namespace base
         virtual ~Task();
 
         virtual void Run() = 0;
+
+        // The object the task works on, for executors that keep one
+        // object's tasks on one thread; 0 when there is none.
+        virtual const void* AffinityKey() const
+        {
+            return 0;
+        }
+
+        // tasks are carved from TaskAllocator's per-thread free lists
+        static void* operator new(size_t size);
+        static void  operator delete(void* ptr);
+
+    private:
+        friend class MpscTaskQueue;
+        friend class LocalTaskQueue;
+
+        // intrusive link used while the task sits in a task queue
+        std::atomic<Task*> next_task_;
+    };
+
+    /*
+     * A task embedded in a longer-lived owner, such as a coroutine frame,
+     * so posting it allocates nothing. Queues run it but never delete it,
+     * and one dropped without running is handed to Abandon() instead.
+     */
+    class IntrusiveTask : public Task
+    {
+    public:
+        virtual void Abandon() = 0;
+    };
+
+    /*
+     * Deferrable work run from the pump's idle time, see
+     * TaskCenter::PostIdleTask. deadline is when the next delayed task
+     * falls due; work running past it makes that task late.
+     */
+    class IdleTask : public Task
+    {
+    public:
+        virtual void Run(const TimeTicks& deadline) = 0;
+
+    private:
+        // idle tasks are only run with a deadline
+        virtual void Run() {}
     };
 
     template<typename Object, typename Method, typename Params>
@@ -22,17 +82,37 @@ namespace base
             : obj_(obj), method_(method), params_(params)
         {}
 
+        MethodTask(Object *obj, Method method, Params &&params)
+            : obj_(obj), method_(method), params_(std::move(params))
+        {}
+
         virtual void Run()
         {
             DispatchToMethod(obj_, method_, params_);
         }
 
+        virtual const void* AffinityKey() const
+        {
+            return obj_;
+        }
+
     private:
         Object  *obj_;
         Method   method_;
         Params   params_;
     };
 
+#if defined(BASE_HAS_VARIADIC_TEMPLATES)
+    // Arguments are forwarded into the task and moved into the method when
+    // it runs, so rvalues and move-only types are never copied.
+    template<typename Object, typename Method, typename... Args>
+    inline Task* NewMethodTask(Object* obj, Method method, Args&&... args)
+    {
+        typedef std::tuple<typename std::decay<Args>::type...> Params;
+        return new MethodTask<Object, Method, Params>(
+            obj, method, Params(std::forward<Args>(args)...));
+    }
+#else
     template<typename Object, typename Method>
     inline Task* NewMethodTask(Object* obj, Method method)
     {
@@ -125,6 +205,60 @@ namespace base
         return new MethodTask<Object, Method, Tuple8<A, B, C, D, E, F, G, H> >(
             obj, method, MakeTuple(a, b, c, d, e, f, g, h));
     }
+#endif
+
+
+    template<typename Callable>
+    class CallableTask : public Task
+    {
+    public:
+        template<typename F>
+        explicit CallableTask(F&& callable)
+            : callable_(std::forward<F>(callable))
+        {}
+
+        virtual void Run()
+        {
+            callable_();
+        }
+
+    private:
+        Callable callable_;
+    };
+
+    // Wraps a lambda or any other callable taking no arguments.
+    template<typename Callable>
+    inline Task* NewCallableTask(Callable&& callable)
+    {
+        return new CallableTask<typename std::decay<Callable>::type>(
+            std::forward<Callable>(callable));
+    }
+
+    template<typename Callable>
+    class CallableIdleTask : public IdleTask
+    {
+    public:
+        template<typename F>
+        explicit CallableIdleTask(F&& callable)
+            : callable_(std::forward<F>(callable))
+        {}
+
+        virtual void Run(const TimeTicks& deadline)
+        {
+            callable_(deadline);
+        }
+
+    private:
+        Callable callable_;
+    };
+
+    // Wraps a callable taking the idle deadline as a const TimeTicks&.
+    template<typename Callable>
+    inline IdleTask* NewIdleTask(Callable&& callable)
+    {
+        return new CallableIdleTask<typename std::decay<Callable>::type>(
+            std::forward<Callable>(callable));
+    }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "task_allocator.h"
+#include "locker.h"
+#include "singleton.h"
+
+#include <new>
+#include <string.h>
+
+namespace base
+{
+    THREAD_LOCAL TaskAllocator* TaskAllocator::current_ = 0;
+
+    // caches of exited threads, waiting for a new thread to take them over
+    static MultiThreadGuard<CSLocker> g_orphans_locker;
+    static TaskAllocator*             g_orphans = 0;
+
+    TaskAllocator::TaskAllocator()
+        : remote_frees_(0)
+        , slab_cursor_(0)
+        , slab_end_(0)
+        , next_orphan_(0)
+    {
+        memset(free_lists_, 0, sizeof(free_lists_));
+        memset(pending_, 0, sizeof(pending_));
+    }
+
+    void* TaskAllocator::Alloc(size_t size)
+    {
+        size_t total = size + sizeof(Header);
+        if (total > kMaxSmallSize)
+        {
+            Header* header = static_cast<Header*>(::operator new(total));
+            header->info.owner = 0;
+            header->info.size_class = kLargeClass;
+            return header + 1;
+        }
+
+        size_t size_class = (total + kClassGranularity - 1) / kClassGranularity - 1;
+        return Current()->AllocSmall(size_class) + 1;
+    }
+
+    void TaskAllocator::Free(void* ptr)
+    {
+        if (!ptr)
+            return;
+
+        Header* header = static_cast<Header*>(ptr) - 1;
+        if (header->info.size_class == kLargeClass)
+        {
+            ::operator delete(header);
+            return;
+        }
+
+        TaskAllocator* current = Current();
+        if (header->info.owner == current)
+            current->FreeLocal(header);
+        else
+            current->FreeRemote(header);
+    }
+
+    void TaskAllocator::FlushRemoteFrees()
+    {
+        if (current_)
+            current_->FlushAll();
+    }
+
+    TaskAllocator* TaskAllocator::Current()
+    {
+        if (!current_)
+        {
+            current_ = Adopt();
+            RegisterThreadExit(OnThreadExit, current_);
+        }
+
+        return current_;
+    }
+
+    TaskAllocator* TaskAllocator::Adopt()
+    {
+        {
+            AutoLocker<CSLocker> guard(&g_orphans_locker);
+            TaskAllocator* allocator = g_orphans;
+            if (allocator)
+            {
+                g_orphans = allocator->next_orphan_;
+                allocator->next_orphan_ = 0;
+                return allocator;
+            }
+        }
+
+        return new TaskAllocator;
+    }
+
+    void TaskAllocator::OnThreadExit(void* arg)
+    {
+        // Blocks other threads return after this keep landing in
+        // remote_frees_, and the adopting thread takes them back with its
+        // first refill.
+        TaskAllocator* allocator = static_cast<TaskAllocator*>(arg);
+        allocator->FlushAll();
+        if (current_ == allocator)
+            current_ = 0;
+
+        AutoLocker<CSLocker> guard(&g_orphans_locker);
+        allocator->next_orphan_ = g_orphans;
+        g_orphans = allocator;
+    }
+
+    TaskAllocator::Block* TaskAllocator::BlockOf(Header* header)
+    {
+        return reinterpret_cast<Block*>(header + 1);
+    }
+
+    TaskAllocator::Header* TaskAllocator::AllocSmall(size_t size_class)
+    {
+        if (!free_lists_[size_class])
+        {
+            ReclaimRemote();
+            if (!free_lists_[size_class])
+                Carve(size_class);
+        }
+
+        Header* header = free_lists_[size_class];
+        free_lists_[size_class] = reinterpret_cast<Header*>(BlockOf(header)->next);
+        return header;
+    }
+
+    void TaskAllocator::FreeLocal(Header* header)
+    {
+        size_t size_class = header->info.size_class;
+        BlockOf(header)->next = reinterpret_cast<Block*>(free_lists_[size_class]);
+        free_lists_[size_class] = header;
+    }
+
+    void TaskAllocator::FreeRemote(Header* header)
+    {
+        TaskAllocator* owner = header->info.owner;
+        PendingBatch* batch = &pending_[(reinterpret_cast<size_t>(owner) >> 6) % kPendingOwners];
+
+        if (batch->owner != owner)
+        {
+            FlushBatch(batch);
+            batch->owner = owner;
+        }
+
+        BlockOf(header)->next = reinterpret_cast<Block*>(batch->head);
+        batch->head = header;
+        if (!batch->tail)
+            batch->tail = header;
+
+        if (++batch->count >= kRemoteBatch)
+            FlushBatch(batch);
+    }
+
+    void TaskAllocator::FlushBatch(PendingBatch* batch)
+    {
+        if (!batch->head)
+            return;
+
+        std::atomic<Header*>& remote_frees = batch->owner->remote_frees_;
+        Header* head = remote_frees.load(std::memory_order_relaxed);
+        do
+        {
+            BlockOf(batch->tail)->next = reinterpret_cast<Block*>(head);
+        } while (!remote_frees.compare_exchange_weak(head, batch->head, std::memory_order_release,
+                                                     std::memory_order_relaxed));
+
+        batch->head = 0;
+        batch->tail = 0;
+        batch->count = 0;
+    }
+
+    void TaskAllocator::FlushAll()
+    {
+        for (int i = 0; i < kPendingOwners; ++i)
+            FlushBatch(&pending_[i]);
+    }
+
+    bool TaskAllocator::ReclaimRemote()
+    {
+        Header* header = remote_frees_.exchange(0, std::memory_order_acquire);
+        if (!header)
+            return false;
+
+        while (header)
+        {
+            Header* next = reinterpret_cast<Header*>(BlockOf(header)->next);
+            FreeLocal(header);
+            header = next;
+        }
+
+        return true;
+    }
+
+    void TaskAllocator::Carve(size_t size_class)
+    {
+        size_t block_size = (size_class + 1) * kClassGranularity;
+        if (slab_cursor_ + block_size > slab_end_)
+        {
+            // the tail of the old slab is too small for this class, leave it
+            slab_cursor_ = static_cast<char*>(::operator new(kSlabSize));
+            slab_end_ = slab_cursor_ + kSlabSize;
+        }
+
+        // carve a handful of blocks at a time so rarely used classes stay small
+        for (int i = 0; i < kRemoteBatch && slab_cursor_ + block_size <= slab_end_; ++i)
+        {
+            Header* header = reinterpret_cast<Header*>(slab_cursor_);
+            header->info.owner = this;
+            header->info.size_class = size_class;
+            FreeLocal(header);
+            slab_cursor_ += block_size;
+        }
+    }
+}
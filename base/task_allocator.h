@@ -0,0 +1,100 @@
+#ifndef __base_task_allocator_h__
+#define __base_task_allocator_h__
+
+#include "base/def.h"
+
+#include <atomic>
+#include <stddef.h>
+
+namespace base
+{
+    /*
+     * Per-thread size-class allocator behind Task::operator new/delete.
+     * Tasks up to kMaxSmallSize bytes come from the allocating thread's
+     * free lists, which are refilled from 64KB slabs. A task deleted on
+     * another thread is queued in a batch for its owner, and the batch
+     * goes back to the owner with one CAS. The owner takes back all of
+     * its returned blocks with one exchange when a free list runs dry.
+     * A batch also goes back once it holds kRemoteBatch blocks, when the
+     * thread's loop runs out of work (FlushRemoteFrees) and when the
+     * thread exits. An exiting thread's cache, slabs and all, cannot be
+     * freed while its blocks may still be live elsewhere, so it is parked
+     * on a global list and the next new thread adopts it; the memory held
+     * is bounded by the peak number of threads, not the number started.
+     */
+    class TaskAllocator
+    {
+    public:
+        static void* Alloc(size_t size);
+        static void  Free(void* ptr);
+
+        // Returns the blocks this thread freed for other threads that are
+        // still waiting in partial batches. For loops about to block, so
+        // blocks do not sit with a thread that has gone idle.
+        static void  FlushRemoteFrees();
+
+    private:
+        union Header
+        {
+            struct
+            {
+                TaskAllocator* owner;
+                size_t         size_class;
+            } info;
+            double             align_double;
+            long long          align_long_long;
+            char               pad[16];
+        };
+
+        struct Block
+        {
+            Block* next;
+        };
+
+        struct PendingBatch
+        {
+            TaskAllocator* owner;
+            Header*        head;
+            Header*        tail;
+            int            count;
+        };
+
+        static const size_t kClassGranularity = 32;
+        static const size_t kMaxSmallSize = 512;
+        static const size_t kSizeClasses = kMaxSmallSize / kClassGranularity;
+        static const size_t kLargeClass = kSizeClasses;
+        static const size_t kSlabSize = 64 * 1024;
+        static const int    kRemoteBatch = 32;
+        static const int    kPendingOwners = 4;
+
+        TaskAllocator();
+
+        static TaskAllocator* Current();
+        static TaskAllocator* Adopt();
+        static void           OnThreadExit(void* arg);
+        static Block*         BlockOf(Header* header);
+
+        Header* AllocSmall(size_t size_class);
+        void    FreeLocal(Header* header);
+        void    FreeRemote(Header* header);
+        void    FlushBatch(PendingBatch* batch);
+        void    FlushAll();
+        bool    ReclaimRemote();
+        void    Carve(size_t size_class);
+
+    private:
+        Header*              free_lists_[kSizeClasses];
+        std::atomic<Header*> remote_frees_;
+        PendingBatch         pending_[kPendingOwners];
+        char*                slab_cursor_;
+        char*                slab_end_;
+        TaskAllocator*       next_orphan_;
+
+        static THREAD_LOCAL TaskAllocator* current_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(TaskAllocator)
+    };
+}
+
+#endif
@@ -1,20 +1,66 @@
 #ifndef __base_message_center_h__
 #define __base_message_center_h__
 
+#include "base/coro.h"
+#include "base/delay_task_queue.h"
+#include "base/local_task_queue.h"
+#include "base/location.h"
 #include "base/locker.h"
+#include "base/mpsc_task_queue.h"
+#include "base/scoped_ptr.h"
 #include "base/task.h"
-#include "base/message_pump.hpp"
+#include "base/task_allocator.h"
+#include "base/task_handle.h"
+#include "base/task_metrics.h"
+#include "base/task_queue_limit.h"
+#include "base/task_runner.h"
+#include "base/time_ticks.h"
+#include "base/trace_event.h"
 #include "base/singleton.h"
 
-#include <queue>
+#if defined(_WIN32)
+#include "base/message_pump.hpp"
+#else
+#include "base/epoll_pump.hpp"
+#endif
+#include "base/futex_pump.hpp"
+
+#include <atomic>
+#include <thread>
 
 namespace base
 {
-    template<template<typename Processor> class Pump>
+    /*
+     * What the Guard of a TaskCenter implies. With MultiThreadGuard any
+     * thread may post. With SingleThreadGuard the center is confined to
+     * the thread that runs it: locks compile away and the queues are
+     * plain lists, and debug builds check that every post comes from
+     * that thread (before Run(), from the first thread to use it).
+     * Quit() may still be called from anywhere.
+     */
+    template<template<typename Locker> class Guard>
+    struct TaskCenterThreading
+    {
+        typedef MpscTaskQueue TaskQueue;
+        static const bool kThreadConfined = false;
+    };
+
+    template<>
+    struct TaskCenterThreading<SingleThreadGuard>
+    {
+        typedef LocalTaskQueue TaskQueue;
+        static const bool kThreadConfined = true;
+    };
+
+    template<template<typename Processor> class Pump,
+             typename DelayQueue = DelayTaskQueue,
+             template<typename Locker> class Guard = MultiThreadGuard>
     class TaskCenter
     {
     public:
         template<typename T> friend class MessagePump;
+        template<typename T> friend class EpollPump;
+        template<typename T> friend class FutexPump;
 
         TaskCenter();
         ~TaskCenter();
@@ -22,52 +68,145 @@ namespace base
         int  Run();
         bool Quit(int code);
 
-        bool PostTask(Task* task);
-        bool PostDelayTask(Task* task, int delay_time);
+        // The center of this type running on the calling thread, 0 on a
+        // thread that runs none; a thread-local load, no lookup.
+        static TaskCenter* Current();
+
+        TaskRunner GetTaskRunner();
+
+        // true on the thread inside Run(). Posts from there skip waking
+        // the pump, which looks at the queues before it next sleeps.
+        bool RunsTasksOnCurrentThread() const;
+
+        // The returned handle is invalid, and the task still belongs to
+        // the caller, when the post fails; unless IsDropped(), see
+        // SetQueueCapacity.
+        TaskHandle PostTask(Task* task, TaskPriority priority = PRIORITY_NORMAL);
+        TaskHandle PostDelayTask(Task* task, int delay_time);
+        TaskHandle PostDelayTask(Task* task, const TimeDelta& delay);
+
+        // The same, attributing the task's latency to FROM_HERE in metrics.
+        TaskHandle PostTask(const Location& from_here, Task* task, TaskPriority priority = PRIORITY_NORMAL);
+        TaskHandle PostDelayTask(const Location& from_here, Task* task, const TimeDelta& delay);
+
+        // Post a task owned by someone else, see IntrusiveTask. A failed
+        // post leaves it untouched.
+        bool PostIntrusiveTask(IntrusiveTask* task, TaskPriority priority = PRIORITY_NORMAL);
+        bool PostIntrusiveDelayTask(IntrusiveTask* task, const TimeDelta& delay);
+
+        // Runs task once the center has nothing else to do: no queued task
+        // and no delayed task due. One idle task runs per pump pass, so
+        // anything posted meanwhile goes first. Tasks that have not run
+        // when the center stops are deleted. A failed post leaves the
+        // task to the caller.
+        bool PostIdleTask(IdleTask* task);
+
+#if defined(BASE_HAS_COROUTINES)
+        // co_await center.Switch() resumes the coroutine on this center,
+        // co_await center.Sleep(delay) does so once delay has passed.
+        CenterAwaiter<TaskCenter> Switch(TaskPriority priority = PRIORITY_NORMAL);
+        CenterAwaiter<TaskCenter> Sleep(const TimeDelta& delay);
+#endif
+
+        // Bounds how much of the task queue one DoTask call drains before
+        // handing control back to the pump. 0 disables a limit, the
+        // default runs a single task per call. The time budget is checked
+        // after every task, so a batch overruns it by at most one task.
+        void SetTaskBudget(int max_tasks, int max_time_us);
+
+        // Levels are served most urgent first. A non-empty level that has
+        // been passed over max_skips times runs next regardless, so lower
+        // levels keep making progress under load; 0 serves the level
+        // strictly by priority.
+        void SetAgingLimit(TaskPriority priority, int max_skips);
+
+        // Tasks posted at the level and not yet run, cancelled ones included.
+        long GetQueueDepth(TaskPriority priority) const;
+
+        // Bounds the tasks waiting in the queues, all levels together;
+        // delayed and idle tasks are not counted. policy says
+        // what a post beyond capacity does. A null block_timeout blocks
+        // until there is room or the center stops; a post from the
+        // center's own thread, which nothing else would make room for, is
+        // rejected instead. A task dropped as the newest is deleted and
+        // its post returns TaskHandle::Dropped(). Only before the first
+        // post and Run().
+        bool SetQueueCapacity(long capacity, QueueOverflowPolicy policy,
+                              const TimeDelta& block_timeout = TimeDelta());
+
+        // See QueueWatermarkObserver. Only before the first post and Run().
+        bool SetQueueWatermarks(long high, long low, QueueWatermarkObserver* observer);
+
+        // Starts recording queue wait, run time, queue depth, delay
+        // lateness and busy time, see TaskMetrics. Only before the first
+        // post and Run(); costs about one clock read per task.
+        bool EnableMetrics();
+        bool GetMetrics(TaskMetricsSnapshot* snapshot) const;
 
     private:
         bool DoTask();
-        bool DoDelayTask(int *next_delay_time);
+        bool DoDelayTask(TimeTicks* next_delayed_run_time);
         bool DoIdleTask();
 
-    private:
-        struct PendingTask
-        {
-            PendingTask() {}
-            PendingTask(Task* task, int delay_time)
-                : task_(task)
-                , time_delay_(delay_time)
-                , time_post_(TimeTicks::Now()) {}
-
-            ~PendingTask() {}
-
-            bool operator< (const PendingTask& task) const
-            {
-                return (time_post_ + time_delay_) < (task.time_delay_ + task.time_post_);
-            }
-
-            Task* task_;
-            int time_post_;
-            int time_delay_;
-        };
+        // queued or idle tasks waiting, for a pump about to sleep
+        bool HasPendingWork() const;
 
-        bool AddToTaskQueue(Task* task);
-        bool AddToDelayTaskQueue(Task* task, int delay_time);
-        Task* GetNextDelayTask();
-        int   GetNextDelayTime();
+        // around window messages the MessagePump dispatches itself
+        void WillProcessMessage();
+        void DidProcessMessage();
+
+    private:
+        typedef typename TaskCenterThreading<Guard>::TaskQueue TaskQueue;
+        static const bool kThreadConfined = TaskCenterThreading<Guard>::kThreadConfined;
+
+        static TaskHandle PostTaskThunk(void* center, const Location& from_here, Task* task, TaskPriority priority);
+        static TaskHandle PostDelayTaskThunk(void* center, const Location& from_here, Task* task, const TimeDelta& delay);
+        static void       CancelDelayTaskThunk(void* center, Task* slot_task, unsigned long long generation);
+
+        void SchedulePump(bool local);
+        void CheckOwnerThread();
+        // what the setters that only work before the first post check
+        void MarkPosted();
+
+        TaskQueueLimit::Admission AdmitTask(bool local);
+        bool  DropOldestTask();
+        bool  AddToTaskQueue(Task* slot_task, TaskPriority priority);
+        Task* GetNextTask();
+        Task* PopNextTask();
+        bool  HasPendingTasks() const;
+        bool  HasQueuedTasks() const;
+        void  AddQueueDepth(int priority, long delta);
+        bool AddToDelayTaskQueue(Task* slot_task, const TimeTicks& delayed_run_time);
+        void RemoveDelayTask(Task* slot_task, unsigned long long generation);
+        int       GetNextDelayTasks(const TimeTicks& now, Task** tasks, TimeTicks* delayed_run_times, int max_tasks);
+        TimeTicks GetNextDelayRunTime();
 
         bool DiscardTasks();
         bool DiscardDelayTasks();
+        bool DiscardIdleTasks();
 
-        void RunTask(Task* task);
+        void      RunTask(Task* task);
+        void      RunTaskWithTrace(Task* task);
+        void      TracePost(Task* slot_task, const Location& from_here);
+        TimeTicks RunTaskWithMetrics(Task* task, const TimeTicks& start, const TimeTicks& delayed_run_time);
+        long      GetTotalQueueDepth() const;
 
-        LONG GetState();
-        void SetState(LONG state);
+        long GetState();
+        void SetState(long state);
 
     private:
-        MultiThreadGuard<CSLocker>       locker_;
-        std::queue<PendingTask>          task_queue_;
-        std::priority_queue<PendingTask> delay_task_queue_;
+        TaskSlotTable              task_slots_;
+        Guard<CSLocker>            locker_;
+        TaskQueue                  task_queues_[PRIORITY_COUNT];
+        std::atomic<long>          queue_depths_[PRIORITY_COUNT];
+        int                        aging_limits_[PRIORITY_COUNT];
+        int                        skip_counts_[PRIORITY_COUNT];
+        DelayQueue                 delay_task_queue_;
+        TaskQueue                  idle_task_queue_;
+        TaskQueueLimit             queue_limit_;
+        // producers dropping the oldest task pop too, under this lock
+        bool                       shared_pop_;
+        mutable Guard<CSLocker>    pop_locker_;
 
         enum State
         {
@@ -75,11 +214,23 @@ namespace base
             STATE_RUNNING = 1L,
             STATE_STOPED  = 2L
         };
-        LONG                       run_state_;
+        int                        max_tasks_per_batch_;
+        int                        max_time_per_batch_;
+        scoped_ptr<TaskMetrics>    metrics_;
+        std::atomic<bool>          posted_;
+        TimeTicks                  message_start_time_;
+        std::atomic<long>          run_state_;
+        std::thread::id            owner_thread_;
         Pump<TaskCenter>           pump_;
+
+        static const TaskRunner::Ops kRunnerOps;
     };
 }
 
+#if defined(_WIN32)
 typedef base::TaskCenter<base::MessagePump> TaskCenterUI;
+#else
+typedef base::TaskCenter<base::EpollPump> TaskCenterIO;
+#endif
 
 #endif
\ No newline at end of file
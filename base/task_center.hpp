@@ -5,23 +5,58 @@
 #include "base/time_ticks.h"
 
 #include <iostream>
+#include <limits.h>
 
 namespace base
 {
-    template<template<typename Processor> class Pump>
-    TaskCenter<Pump>::TaskCenter()
-        : run_state_(STATE_DEFAULT) {}
+    // how many times a waiting level may be passed over before it is served
+    static const int kDefaultAgingLimits[PRIORITY_COUNT] = { 0, 4, 16, 64 };
 
-    template<template<typename Processor> class Pump>
-    TaskCenter<Pump>::~TaskCenter()
+    // the longest idle deadline, when no delayed task bounds it sooner
+    static const int kMaxIdlePeriodMs = 50;
+
+    // due delayed tasks taken out per hold of the delay queue lock
+    static const int kDelayTaskBatch = 32;
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    const TaskRunner::Ops TaskCenter<Pump, DelayQueue, Guard>::kRunnerOps =
+    {
+        &TaskCenter<Pump, DelayQueue, Guard>::PostTaskThunk,
+        &TaskCenter<Pump, DelayQueue, Guard>::PostDelayTaskThunk
+    };
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskCenter<Pump, DelayQueue, Guard>::TaskCenter()
+        : shared_pop_(false)
+        , max_tasks_per_batch_(1)
+        , max_time_per_batch_(0)
+        , posted_(false)
+        , run_state_(STATE_DEFAULT)
+    {
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            queue_depths_[i].store(0);
+            aging_limits_[i] = kDefaultAgingLimits[i];
+            skip_counts_[i] = 0;
+        }
+
+        task_slots_.SetCancelHook(&CancelDelayTaskThunk, this);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskCenter<Pump, DelayQueue, Guard>::~TaskCenter()
     {
+        queue_limit_.Close();
         DiscardTasks();
         DiscardDelayTasks();
+        DiscardIdleTasks();
     }
 
-    template<template<typename Processor> class Pump>
-    int TaskCenter<Pump>::Run()
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    int TaskCenter<Pump, DelayQueue, Guard>::Run()
     {
+        CheckOwnerThread();
+
         if (GetState() != STATE_DEFAULT)
         {
             return 0;
@@ -29,15 +64,20 @@ namespace base
 
         SetState(STATE_RUNNING);
 
-        int code = pump_.Run(this);
+        int code = 0;
+        {
+            TaskRunner::ScopedCurrent current(GetTaskRunner());
+            code = pump_.Run(this);
+        }
 
         SetState(STATE_STOPED);
+        queue_limit_.Close();
 
         return code;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::Quit(int code)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::Quit(int code)
     {
         if (GetState() == STATE_RUNNING)
         {
@@ -47,213 +87,924 @@ namespace base
         return true;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::PostTask(Task* task)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskCenter<Pump, DelayQueue, Guard>* TaskCenter<Pump, DelayQueue, Guard>::Current()
     {
-        if (GetState() == STATE_STOPED)
+        return static_cast<TaskCenter*>(TaskRunner::CurrentCenter(&kRunnerOps));
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskRunner TaskCenter<Pump, DelayQueue, Guard>::GetTaskRunner()
+    {
+        return TaskRunner(this, &kRunnerOps);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::RunsTasksOnCurrentThread() const
+    {
+        return TaskRunner::CurrentCenter(&kRunnerOps) == this;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskHandle TaskCenter<Pump, DelayQueue, Guard>::PostTask(Task* task, TaskPriority priority)
+    {
+        return PostTask(Location(), task, priority);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskHandle TaskCenter<Pump, DelayQueue, Guard>::PostTask(const Location& from_here, Task* task, TaskPriority priority)
+    {
+        CheckOwnerThread();
+
+        TaskHandle handle;
+        if (!task || priority < 0 || priority >= PRIORITY_COUNT || GetState() == STATE_STOPED)
         {
-            return false;
+            return handle;
         }
 
-        if (AddToTaskQueue(task))
+        MarkPosted();
+
+        bool local = RunsTasksOnCurrentThread();
+
+        TaskQueueLimit::Admission admission = TaskQueueLimit::ADMIT;
+        if (queue_limit_.IsActive())
         {
-            pump_.ScheduleTask();
-            return true;
+            admission = AdmitTask(local);
+            if (admission == TaskQueueLimit::REJECT)
+            {
+                return handle;
+            }
         }
 
-        return false;
+        if (admission == TaskQueueLimit::DROP_NEWEST)
+        {
+            delete task;
+            return TaskHandle::Dropped();
+        }
+
+        Task* slot_task = task_slots_.Wrap(task, &handle);
+
+        if (slot_task && metrics_.get())
+        {
+            TaskSlotTable::SetPostInfo(slot_task, TimeTicks::Now(), from_here);
+        }
+
+        if (slot_task && TraceLog::IsEnabled())
+        {
+            TracePost(slot_task, from_here);
+        }
+
+        if (AddToTaskQueue(slot_task, priority))
+        {
+            SchedulePump(local);
+        }
+
+        return handle;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskHandle TaskCenter<Pump, DelayQueue, Guard>::PostDelayTask(Task* task, int delay_time)
+    {
+        return PostDelayTask(task, TimeDelta::FromMilliseconds(delay_time));
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskHandle TaskCenter<Pump, DelayQueue, Guard>::PostDelayTask(Task* task, const TimeDelta& delay)
+    {
+        return PostDelayTask(Location(), task, delay);
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::PostDelayTask(Task* task, int delay_time)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskHandle TaskCenter<Pump, DelayQueue, Guard>::PostDelayTask(const Location& from_here, Task* task, const TimeDelta& delay)
     {
-        if (GetState() == STATE_STOPED)
+        CheckOwnerThread();
+
+        TaskHandle handle;
+        if (!task || GetState() == STATE_STOPED)
+        {
+            return handle;
+        }
+
+        MarkPosted();
+
+        // lateness is measured from the due time, only the site is kept
+        Task* slot_task = task_slots_.Wrap(task, &handle);
+        if (slot_task && metrics_.get())
+        {
+            TaskSlotTable::SetPostInfo(slot_task, TimeTicks(), from_here);
+        }
+
+        if (slot_task && TraceLog::IsEnabled())
+        {
+            TracePost(slot_task, from_here);
+        }
+
+        TimeTicks delayed_run_time = TimeTicks::Now() + delay;
+        if (AddToDelayTaskQueue(slot_task, delayed_run_time))
+        {
+            pump_.ScheduleDelayTask(delayed_run_time);
+        }
+
+        return handle;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::PostIntrusiveTask(IntrusiveTask* task, TaskPriority priority)
+    {
+        CheckOwnerThread();
+
+        if (!task || priority < 0 || priority >= PRIORITY_COUNT || GetState() == STATE_STOPED)
         {
             return false;
         }
 
-        if (AddToDelayTaskQueue(task, delay_time))
+        MarkPosted();
+
+        bool local = RunsTasksOnCurrentThread();
+
+        // the owner keeps a task the center would drop, as if rejected
+        if (queue_limit_.IsActive())
         {
-            pump_.ScheduleDelayTask();
-            return true;
+            TaskQueueLimit::Admission admission = AdmitTask(local);
+            if (admission == TaskQueueLimit::REJECT || admission == TaskQueueLimit::DROP_NEWEST)
+            {
+                return false;
+            }
         }
 
-        return false;
+        Task* slot_task = task_slots_.WrapIntrusive(task, 0);
+        if (slot_task && metrics_.get())
+        {
+            TaskSlotTable::SetPostInfo(slot_task, TimeTicks::Now(), Location());
+        }
+
+        if (slot_task && TraceLog::IsEnabled())
+        {
+            TracePost(slot_task, Location());
+        }
+
+        if (!AddToTaskQueue(slot_task, priority))
+        {
+            return false;
+        }
+
+        SchedulePump(local);
+        return true;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::AddToTaskQueue(Task* task)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::PostIntrusiveDelayTask(IntrusiveTask* task, const TimeDelta& delay)
     {
-        if (!task)
+        CheckOwnerThread();
+
+        if (!task || GetState() == STATE_STOPED)
         {
             return false;
         }
 
-        AutoLocker<CSLocker> guard(&locker_);
-        task_queue_.push(PendingTask(task,0));
+        MarkPosted();
+
+        Task* slot_task = task_slots_.WrapIntrusive(task, 0);
+        if (slot_task && TraceLog::IsEnabled())
+        {
+            TracePost(slot_task, Location());
+        }
+
+        TimeTicks delayed_run_time = TimeTicks::Now() + delay;
+        if (!AddToDelayTaskQueue(slot_task, delayed_run_time))
+        {
+            return false;
+        }
+
+        pump_.ScheduleDelayTask(delayed_run_time);
         return true;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::AddToDelayTaskQueue(Task* task, int delay_time)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::PostIdleTask(IdleTask* task)
     {
-        if (!task)
+        CheckOwnerThread();
+
+        if (!task || GetState() == STATE_STOPED)
         {
             return false;
         }
 
-        AutoLocker<CSLocker> guard(&locker_);
-        delay_task_queue_.push(PendingTask(task,delay_time));
+        MarkPosted();
+
+        // wake a pump blocked with nothing to do, so it gets to DoIdleTask
+        idle_task_queue_.Push(task);
+        SchedulePump(RunsTasksOnCurrentThread());
         return true;
     }
 
-    template<template<typename Processor> class Pump>
-    Task* TaskCenter<Pump>::GetNextDelayTask()
+#if defined(BASE_HAS_COROUTINES)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    CenterAwaiter<TaskCenter<Pump, DelayQueue, Guard> > TaskCenter<Pump, DelayQueue, Guard>::Switch(TaskPriority priority)
     {
-        AutoLocker<CSLocker> guard(&locker_);
-        if (delay_task_queue_.empty())
-            return 0;
+        return CenterAwaiter<TaskCenter>(this, priority);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    CenterAwaiter<TaskCenter<Pump, DelayQueue, Guard> > TaskCenter<Pump, DelayQueue, Guard>::Sleep(const TimeDelta& delay)
+    {
+        return CenterAwaiter<TaskCenter>(this, delay);
+    }
+#endif
 
-        PendingTask pending_task = delay_task_queue_.top();
-        if (pending_task.time_post_ + pending_task.time_delay_ < TimeTicks::Now())
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::SetTaskBudget(int max_tasks, int max_time_us)
+    {
+        max_tasks_per_batch_ = max_tasks;
+        max_time_per_batch_ = max_time_us;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::SetAgingLimit(TaskPriority priority, int max_skips)
+    {
+        if (priority < 0 || priority >= PRIORITY_COUNT)
         {
-            delay_task_queue_.pop();
-            return pending_task.task_;
+            return;
         }
 
-        return 0;
+        aging_limits_[priority] = max_skips;
     }
 
-    template<template<typename Processor> class Pump>
-    int TaskCenter<Pump>::GetNextDelayTime()
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    long TaskCenter<Pump, DelayQueue, Guard>::GetQueueDepth(TaskPriority priority) const
     {
-        AutoLocker<CSLocker> guard(&locker_);
-        if (delay_task_queue_.empty())
+        if (priority < 0 || priority >= PRIORITY_COUNT)
+        {
             return 0;
+        }
 
-        PendingTask pending_task = delay_task_queue_.top();
-        return pending_task.time_delay_;
+        return queue_depths_[priority].load(std::memory_order_relaxed);
     }
 
-    template<template<typename Processor> class Pump>
-    LONG TaskCenter<Pump>::GetState()
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::SetQueueCapacity(long capacity, QueueOverflowPolicy policy,
+                                                         const TimeDelta& block_timeout)
     {
-        return InterlockedExchangeAdd(&run_state_, 0L);
+        if (GetState() != STATE_DEFAULT || posted_.load())
+        {
+            return false;
+        }
+
+        queue_limit_.SetCapacity(capacity, policy, block_timeout);
+        shared_pop_ = capacity > 0 && policy == OVERFLOW_DROP_OLDEST;
+        return true;
     }
 
-    template<template<typename Processor> class Pump>
-    void TaskCenter<Pump>::SetState(LONG state)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::SetQueueWatermarks(long high, long low, QueueWatermarkObserver* observer)
     {
-        InterlockedExchange(&run_state_, state);
+        if (GetState() != STATE_DEFAULT || posted_.load())
+        {
+            return false;
+        }
+
+        queue_limit_.SetWatermarks(high, low, observer);
+        return true;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::DiscardTasks()
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::EnableMetrics()
     {
-        if (GetState() == STATE_RUNNING)
+        // metrics_ is read unlocked by every post
+        if (GetState() != STATE_DEFAULT || posted_.load() || metrics_.get())
         {
             return false;
         }
 
-        AutoLocker<CSLocker> guard(&locker_);
-        while (!task_queue_.empty())
+        metrics_.reset(new TaskMetrics());
+        return true;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::GetMetrics(TaskMetricsSnapshot* snapshot) const
+    {
+        if (!metrics_.get() || !snapshot)
         {
-            PendingTask pending_task = task_queue_.front();
-            task_queue_.pop();
+            return false;
+        }
 
-            delete pending_task.task_;
+        metrics_->Snapshot(snapshot);
+        return true;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskHandle TaskCenter<Pump, DelayQueue, Guard>::PostTaskThunk(void* center, const Location& from_here,
+                                                           Task* task, TaskPriority priority)
+    {
+        return static_cast<TaskCenter*>(center)->PostTask(from_here, task, priority);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskHandle TaskCenter<Pump, DelayQueue, Guard>::PostDelayTaskThunk(void* center, const Location& from_here,
+                                                                Task* task, const TimeDelta& delay)
+    {
+        return static_cast<TaskCenter*>(center)->PostDelayTask(from_here, task, delay);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::CancelDelayTaskThunk(void* center, Task* slot_task,
+                                                                   unsigned long long generation)
+    {
+        static_cast<TaskCenter*>(center)->RemoveDelayTask(slot_task, generation);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::SchedulePump(bool local)
+    {
+        // the pump's own thread is running a task or a timer or idle
+        // callback, never asleep; it only has to be told to look again
+        if (local)
+            pump_.ScheduleLocalTask();
+        else
+            pump_.ScheduleTask();
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::CheckOwnerThread()
+    {
+#if !defined(NDEBUG)
+        if (kThreadConfined)
+        {
+            std::thread::id current = std::this_thread::get_id();
+            if (owner_thread_ == std::thread::id())
+                owner_thread_ = current;
+
+            BASE_DCHECK(owner_thread_ == current && "thread-confined TaskCenter used from another thread");
+        }
+#endif
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::MarkPosted()
+    {
+        // read first, so later posts share the line instead of writing it
+        if (!posted_.load(std::memory_order_relaxed))
+            posted_.store(true, std::memory_order_relaxed);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TaskQueueLimit::Admission TaskCenter<Pump, DelayQueue, Guard>::AdmitTask(bool local)
+    {
+        // a full queue may drain between the two calls, then just try again;
+        // the center's own thread cannot wait for itself to drain it
+        while (true)
+        {
+            TaskQueueLimit::Admission admission = queue_limit_.Acquire(!local);
+            if (admission != TaskQueueLimit::ADMIT_DROP_OLDEST || DropOldestTask())
+            {
+                return admission;
+            }
+        }
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::DropOldestTask()
+    {
+        // the new task takes the dropped one's place in the count
+        Task* task = 0;
+        {
+            AutoLocker<CSLocker, Guard> guard(&pop_locker_);
+            for (int i = PRIORITY_COUNT - 1; i >= 0 && !task; --i)
+            {
+                task = task_queues_[i].Pop();
+                if (task)
+                    AddQueueDepth(i, -1);
+            }
+        }
+
+        if (!task)
+        {
+            return false;
         }
 
+        TaskSlotTable::Discard(task);
         return true;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::DiscardDelayTasks()
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::AddToTaskQueue(Task* slot_task, TaskPriority priority)
     {
-        if (GetState() == STATE_RUNNING)
+        if (!slot_task)
         {
+            if (queue_limit_.IsActive())
+                queue_limit_.Release();
+
             return false;
         }
 
-        AutoLocker<CSLocker> guard(&locker_);
-        while (!delay_task_queue_.empty())
+        AddQueueDepth(priority, 1);
+        task_queues_[priority].Push(slot_task);
+        return true;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    Task* TaskCenter<Pump, DelayQueue, Guard>::GetNextTask()
+    {
+        Task* task = 0;
+        if (shared_pop_)
+        {
+            AutoLocker<CSLocker, Guard> guard(&pop_locker_);
+            task = PopNextTask();
+        }
+        else
+        {
+            task = PopNextTask();
+        }
+
+        if (task && queue_limit_.IsActive())
+        {
+            queue_limit_.Release();
+        }
+
+        return task;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    Task* TaskCenter<Pump, DelayQueue, Guard>::PopNextTask()
+    {
+        // the most urgent non-empty level wins unless a level below it has
+        // waited out its aging limit; every level passed over ages by one
+        int level = -1;
+        int aged_level = -1;
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            if (task_queues_[i].Empty())
+                continue;
+
+            if (level < 0)
+            {
+                level = i;
+                continue;
+            }
+
+            if (aging_limits_[i] > 0 && ++skip_counts_[i] >= aging_limits_[i] && aged_level < 0)
+                aged_level = i;
+        }
+
+        if (aged_level >= 0)
+        {
+            level = aged_level;
+        }
+
+        if (level < 0)
         {
-            PendingTask pending_task = delay_task_queue_.top();
-            delay_task_queue_.pop();
+            return 0;
+        }
 
-            delete pending_task.task_;
+        skip_counts_[level] = 0;
+
+        Task* task = task_queues_[level].Pop();
+        if (task)
+        {
+            AddQueueDepth(level, -1);
         }
 
+        return task;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::AddQueueDepth(int priority, long delta)
+    {
+        // with one thread writing, a load and a store do without the
+        // locked read-modify-write
+        if (kThreadConfined)
+            queue_depths_[priority].store(queue_depths_[priority].load(std::memory_order_relaxed) + delta,
+                                          std::memory_order_relaxed);
+        else
+            queue_depths_[priority].fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    long TaskCenter<Pump, DelayQueue, Guard>::GetTotalQueueDepth() const
+    {
+        long depth = 0;
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            depth += queue_depths_[i].load(std::memory_order_relaxed);
+        }
+
+        return depth;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::HasPendingTasks() const
+    {
+        if (shared_pop_)
+        {
+            AutoLocker<CSLocker, Guard> guard(&pop_locker_);
+            return HasQueuedTasks();
+        }
+
+        return HasQueuedTasks();
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::HasQueuedTasks() const
+    {
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            if (!task_queues_[i].Empty())
+                return true;
+        }
+
+        return false;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::AddToDelayTaskQueue(Task* slot_task, const TimeTicks& delayed_run_time)
+    {
+        if (!slot_task)
+        {
+            return false;
+        }
+
+        AutoLocker<CSLocker, Guard> guard(&locker_);
+        TaskSlotTable::SetDelayEntry(slot_task, delay_task_queue_.Push(slot_task, delayed_run_time));
         return true;
     }
 
-    template<template<typename Processor> class Pump>
-    void TaskCenter<Pump>::RunTask(Task* task)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::RemoveDelayTask(Task* slot_task, unsigned long long generation)
     {
+        // a slot popped meanwhile had its entry cleared under this lock,
+        // and one reused since is no longer cancelled at generation
+        AutoLocker<CSLocker, Guard> guard(&locker_);
+        void* entry = TaskSlotTable::TakeDelayEntry(slot_task, generation);
+        if (!entry)
+        {
+            return;
+        }
+
+        Task* task = delay_task_queue_.Remove(static_cast<typename DelayQueue::Handle>(entry));
         if (task)
         {
-            task->Run();
+            TaskSlotTable::Discard(task);
+        }
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    int TaskCenter<Pump, DelayQueue, Guard>::GetNextDelayTasks(const TimeTicks& now, Task** tasks,
+                                                               TimeTicks* delayed_run_times, int max_tasks)
+    {
+        // Cancelled slots whose canceller has not yet got to this lock are
+        // dropped here in the same pass, so a batch only holds live tasks.
+        // Returns fewer than max_tasks once nothing more is due.
+        AutoLocker<CSLocker, Guard> guard(&locker_);
+        int count = 0;
+        while (count < max_tasks)
+        {
+            TimeTicks delayed_run_time;
+            if (delayed_run_times)
+            {
+                delayed_run_time = delay_task_queue_.NextExpireTime();
+            }
+
+            Task* task = delay_task_queue_.PopExpired(now);
+            if (!task)
+            {
+                break;
+            }
+
+            TaskSlotTable::SetDelayEntry(task, 0);
+            if (TaskSlotTable::IsCancelled(task))
+            {
+                TaskSlotTable::Discard(task);
+                continue;
+            }
+
+            if (delayed_run_times)
+            {
+                delayed_run_times[count] = delayed_run_time;
+            }
+
+            tasks[count++] = task;
         }
 
-        delete task;
+        return count;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::DoTask()
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TimeTicks TaskCenter<Pump, DelayQueue, Guard>::GetNextDelayRunTime()
     {
-        bool has_more_task = false;
+        AutoLocker<CSLocker, Guard> guard(&locker_);
+        return delay_task_queue_.NextExpireTime();
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    long TaskCenter<Pump, DelayQueue, Guard>::GetState()
+    {
+        return run_state_.load();
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::SetState(long state)
+    {
+        run_state_.store(state);
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::DiscardTasks()
+    {
+        if (GetState() == STATE_RUNNING)
         {
-            AutoLocker<CSLocker> guard(&locker_);
-            has_more_task = !task_queue_.empty();
+            return false;
         }
 
-        if (!has_more_task)
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            while (Task* task = task_queues_[i].Pop())
+            {
+                // the limit goes with the center: no Release(), which
+                // would tell the observer of a drain on a center half gone
+                AddQueueDepth(i, -1);
+                TaskSlotTable::Discard(task);
+            }
+        }
+
+        return true;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::DiscardDelayTasks()
+    {
+        if (GetState() == STATE_RUNNING)
         {
             return false;
         }
 
-        PendingTask pending_task;
+        AutoLocker<CSLocker, Guard> guard(&locker_);
+        TimeTicks end_of_time = TimeTicks::FromInternalValue(LLONG_MAX);
+        while (Task* task = delay_task_queue_.PopExpired(end_of_time))
+        {
+            TaskSlotTable::Discard(task);
+        }
+
+        return true;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::DiscardIdleTasks()
+    {
+        if (GetState() == STATE_RUNNING)
         {
-            AutoLocker<CSLocker> guard(&locker_);
-            pending_task = task_queue_.front();
-            task_queue_.pop();
+            return false;
         }
-        RunTask(pending_task.task_);
 
+        while (Task* task = idle_task_queue_.Pop())
         {
-            AutoLocker<CSLocker> guard(&locker_);
-            has_more_task = !task_queue_.empty();
+            delete task;
         }
-        return has_more_task;
+
+        return true;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::DoDelayTask(int *next_delay_time)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::RunTask(Task* task)
     {
+        // queued tasks are slots, which skip cancelled tasks, delete the
+        // ones they run and recycle themselves
+        if (!task)
+        {
+            return;
+        }
+
+        if (TraceLog::IsEnabled())
+        {
+            RunTaskWithTrace(task);
+            return;
+        }
+
+        task->Run();
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::RunTaskWithTrace(Task* task)
+    {
+        // the slot is recycled by the run, read what it carries first
+        unsigned long long trace_id = TaskSlotTable::TraceIdOf(task);
+
+        TraceLog::Begin("task", "RunTask", TaskSlotTable::LocationOf(task));
+        if (trace_id)
+        {
+            TraceLog::FlowEnd("task", "PostTask", trace_id);
+        }
+
+        task->Run();
+
+        TraceLog::End("task", "RunTask");
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::TracePost(Task* slot_task, const Location& from_here)
+    {
+        // a short slice on the posting thread for the flow arrow to start
+        // from; the site goes with the slot so the run slice names it too
+        TaskSlotTable::SetPostInfo(slot_task, TaskSlotTable::PostTimeOf(slot_task), from_here);
+
+        TraceLog::Begin("task", "PostTask", from_here);
+        TaskSlotTable::SetTraceId(slot_task, TraceLog::FlowBegin("task", "PostTask"));
+        TraceLog::End("task", "PostTask");
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    TimeTicks TaskCenter<Pump, DelayQueue, Guard>::RunTaskWithMetrics(Task* task, const TimeTicks& start, const TimeTicks& delayed_run_time)
+    {
+        // the slot is recycled by the run, read what it carries first
+        TimeTicks post_time = TaskSlotTable::PostTimeOf(task);
+        Location from_here = TaskSlotTable::LocationOf(task);
+
+        RunTask(task);
+
+        TimeTicks end = TimeTicks::Now();
+        if (!delayed_run_time.is_null())
+        {
+            metrics_->RecordDelayTask(start - delayed_run_time, end - start, from_here);
+        }
+        else
+        {
+            metrics_->RecordTask(post_time.is_null() ? TimeDelta() : start - post_time,
+                                 end - start, from_here);
+        }
+
+        return end;
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::DoTask()
+    {
+        Task* task = GetNextTask();
+        if (!task)
+        {
+            return false;
+        }
+
+        TaskMetrics* metrics = metrics_.get();
+
+        TimeTicks start;
+        if (max_time_per_batch_ > 0 || metrics)
+        {
+            start = TimeTicks::Now();
+        }
+
+        TimeTicks deadline;
+        if (max_time_per_batch_ > 0)
+        {
+            deadline = start + TimeDelta::FromMicroseconds(max_time_per_batch_);
+        }
+
+        if (metrics)
+        {
+            metrics->RecordQueueDepth(GetTotalQueueDepth() + 1);
+        }
+
+        TimeTicks now = start;
+        int run_count = 0;
         do
         {
-            Task* task = GetNextDelayTask();
-            if (!task)
+            if (metrics)
+                now = RunTaskWithMetrics(task, now, TimeTicks());
+            else
+                RunTask(task);
+            ++run_count;
+
+            if (max_tasks_per_batch_ > 0 && run_count >= max_tasks_per_batch_)
                 break;
 
-            RunTask(task);
+            // one slow task spends the budget, so look at the clock after
+            // each; with metrics on, now is already the task's end time
+            if (!deadline.is_null())
+            {
+                if (!metrics)
+                    now = TimeTicks::Now();
+                if (now >= deadline)
+                    break;
+            }
+
+            task = GetNextTask();
+        } while (task);
+
+        // a task message dispatched by the MessagePump is already counted
+        if (metrics && message_start_time_.is_null())
+        {
+            metrics->RecordBusy(now - start);
+        }
 
-        } while (true);
+        return HasPendingTasks();
+    }
 
-        int delay = GetNextDelayTime();
-        if (delay > 0)
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::DoDelayTask(TimeTicks* next_delayed_run_time)
+    {
+        // tasks that fall due while this batch runs wait for the next
+        // wakeup, so a task reposting itself cannot starve the pump
+        TaskMetrics* metrics = metrics_.get();
+
+        TimeTicks now = TimeTicks::Now();
+        TimeTicks end = now;
+        Task* tasks[kDelayTaskBatch];
+        TimeTicks delayed_run_times[kDelayTaskBatch];
+        int count = 0;
+        do
+        {
+            count = GetNextDelayTasks(now, tasks, metrics ? delayed_run_times : 0, kDelayTaskBatch);
+            for (int i = 0; i < count; ++i)
+            {
+                if (metrics)
+                    end = RunTaskWithMetrics(tasks[i], end, delayed_run_times[i]);
+                else
+                    RunTask(tasks[i]);
+            }
+
+        } while (count == kDelayTaskBatch);
+
+        if (metrics && message_start_time_.is_null())
         {
-            *next_delay_time = delay;
+            metrics->RecordBusy(end - now);
+        }
+
+        TimeTicks delayed_run_time = GetNextDelayRunTime();
+        if (!delayed_run_time.is_null())
+        {
+            *next_delayed_run_time = delayed_run_time;
             return true;
         }
 
         return false;
     }
 
-    template<template<typename Processor> class Pump>
-    bool TaskCenter<Pump>::DoIdleTask()
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::DoIdleTask()
     {
-        return false;
+        // the pump is out of work and may block, hand back the blocks of
+        // other threads' tasks this thread deleted
+        TaskAllocator::FlushRemoteFrees();
+
+        if (idle_task_queue_.Empty() || HasPendingTasks())
+        {
+            return false;
+        }
+
+        // a due delayed task goes first, the pump runs it on its timer
+        TimeTicks now = TimeTicks::Now();
+        TimeTicks deadline = now + TimeDelta::FromMilliseconds(kMaxIdlePeriodMs);
+        TimeTicks delayed_run_time = GetNextDelayRunTime();
+        if (!delayed_run_time.is_null())
+        {
+            if (delayed_run_time <= now)
+                return false;
+
+            if (delayed_run_time < deadline)
+                deadline = delayed_run_time;
+        }
+
+        IdleTask* task = static_cast<IdleTask*>(idle_task_queue_.Pop());
+        if (!task)
+        {
+            return false;
+        }
+
+        {
+            TRACE_EVENT("task", "RunIdleTask");
+            task->Run(deadline);
+        }
+        delete task;
+
+        if (metrics_.get())
+        {
+            metrics_->RecordBusy(TimeTicks::Now() - now);
+        }
+
+        return !idle_task_queue_.Empty();
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    bool TaskCenter<Pump, DelayQueue, Guard>::HasPendingWork() const
+    {
+        return HasPendingTasks() || !idle_task_queue_.Empty();
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::WillProcessMessage()
+    {
+        if (metrics_.get())
+        {
+            message_start_time_ = TimeTicks::Now();
+        }
+    }
+
+    template<template<typename Processor> class Pump, typename DelayQueue, template<typename Locker> class Guard>
+    void TaskCenter<Pump, DelayQueue, Guard>::DidProcessMessage()
+    {
+        if (metrics_.get() && !message_start_time_.is_null())
+        {
+            metrics_->RecordBusy(TimeTicks::Now() - message_start_time_);
+            message_start_time_ = TimeTicks();
+        }
     }
 }
 
@@ -0,0 +1,288 @@
+#include "task_handle.h"
+
+namespace base
+{
+    TaskHandle::TaskHandle()
+        : table_(0)
+        , index_(0)
+        , generation_(0) {}
+
+    TaskHandle::TaskHandle(TaskSlotTable* table, unsigned int index, unsigned long long generation)
+        : table_(table)
+        , index_(index)
+        , generation_(generation) {}
+
+    bool TaskHandle::Cancel()
+    {
+        if (!table_)
+            return false;
+
+        return table_->Cancel(index_, generation_);
+    }
+
+    bool TaskHandle::IsValid() const
+    {
+        return table_ != 0;
+    }
+
+    TaskHandle TaskHandle::Dropped()
+    {
+        return TaskHandle(0, kDroppedIndex, 0);
+    }
+
+    bool TaskHandle::IsDropped() const
+    {
+        return !table_ && index_ == kDroppedIndex;
+    }
+
+
+    TaskSlotTable::Slot::Slot()
+        : table(0)
+        , index(0)
+        , task(0)
+        , state(0)
+        , next_free(0)
+        , delay_entry(0)
+        , intrusive(false)
+        , trace_id(0) {}
+
+    void TaskSlotTable::Slot::Run()
+    {
+        unsigned long long current = state.load(std::memory_order_acquire);
+        unsigned long long generation = current >> kStatusBits;
+
+        unsigned long long expected = MakeState(generation, STATUS_PENDING);
+        if (state.compare_exchange_strong(expected, MakeState(generation, STATUS_RUNNING),
+                                          std::memory_order_acq_rel))
+        {
+            Task* pending = task.load(std::memory_order_relaxed);
+            pending->Run();
+            if (!intrusive)
+                delete pending;
+        }
+
+        task.store(0, std::memory_order_relaxed);
+        table->Release(this);
+    }
+
+    TaskSlotTable::TaskSlotTable()
+        : size_(0)
+        , free_head_(0)
+        , cancel_hook_(0)
+        , cancel_context_(0)
+    {
+        for (unsigned int i = 0; i < kMaxChunks; ++i)
+            chunks_[i].store(0, std::memory_order_relaxed);
+    }
+
+    TaskSlotTable::~TaskSlotTable()
+    {
+        for (unsigned int i = 0; i < kMaxChunks; ++i)
+            delete [] chunks_[i].load(std::memory_order_relaxed);
+    }
+
+    void TaskSlotTable::SetCancelHook(CancelHook hook, void* context)
+    {
+        cancel_hook_ = hook;
+        cancel_context_ = context;
+    }
+
+    Task* TaskSlotTable::Wrap(Task* task, TaskHandle* handle)
+    {
+        return WrapTask(task, false, handle);
+    }
+
+    Task* TaskSlotTable::WrapIntrusive(IntrusiveTask* task, TaskHandle* handle)
+    {
+        return WrapTask(task, true, handle);
+    }
+
+    Task* TaskSlotTable::WrapTask(Task* task, bool intrusive, TaskHandle* handle)
+    {
+        Slot* slot = Alloc();
+        if (!slot)
+            return 0;
+
+        unsigned long long generation = slot->state.load(std::memory_order_relaxed) >> kStatusBits;
+        slot->task.store(task, std::memory_order_relaxed);
+        slot->delay_entry.store(0, std::memory_order_relaxed);
+        slot->intrusive = intrusive;
+        slot->post_time = TimeTicks();
+        slot->from_here = Location();
+        slot->trace_id = 0;
+        slot->state.store(MakeState(generation, STATUS_PENDING), std::memory_order_release);
+
+        if (handle)
+            *handle = TaskHandle(this, slot->index, generation);
+
+        return slot;
+    }
+
+    bool TaskSlotTable::Cancel(unsigned int index, unsigned long long generation)
+    {
+        Slot* slot = At(index);
+        if (!slot)
+            return false;
+
+        unsigned long long expected = MakeState(generation, STATUS_PENDING);
+        if (slot->state.load(std::memory_order_acquire) != expected)
+            return false;
+
+        // the generation only grows, so a successful exchange below proves
+        // the slot still held this task when it was read
+        Task* task = slot->task.load(std::memory_order_relaxed);
+        if (!slot->state.compare_exchange_strong(expected, MakeState(generation, STATUS_CANCELLED),
+                                                 std::memory_order_acq_rel))
+        {
+            return false;
+        }
+
+        // the slot stays queued as a tombstone until the consumer reaches
+        // it, unless its delay queue can take it out now
+        DropTask(slot, task);
+        if (cancel_hook_ && slot->delay_entry.load(std::memory_order_relaxed))
+            cancel_hook_(cancel_context_, slot, generation);
+
+        return true;
+    }
+
+    void TaskSlotTable::Discard(Task* slot_task)
+    {
+        Slot* slot = static_cast<Slot*>(slot_task);
+
+        unsigned long long generation = slot->state.load(std::memory_order_acquire) >> kStatusBits;
+        unsigned long long expected = MakeState(generation, STATUS_PENDING);
+        if (slot->state.compare_exchange_strong(expected, MakeState(generation, STATUS_CANCELLED),
+                                                std::memory_order_acq_rel))
+        {
+            DropTask(slot, slot->task.load(std::memory_order_relaxed));
+        }
+
+        slot->task.store(0, std::memory_order_relaxed);
+        slot->table->Release(slot);
+    }
+
+    bool TaskSlotTable::IsCancelled(Task* slot_task)
+    {
+        Slot* slot = static_cast<Slot*>(slot_task);
+        return (slot->state.load(std::memory_order_acquire) & kStatusMask) == STATUS_CANCELLED;
+    }
+
+    void TaskSlotTable::SetPostInfo(Task* slot_task, const TimeTicks& post_time, const Location& from_here)
+    {
+        Slot* slot = static_cast<Slot*>(slot_task);
+        slot->post_time = post_time;
+        slot->from_here = from_here;
+    }
+
+    TimeTicks TaskSlotTable::PostTimeOf(Task* slot_task)
+    {
+        return static_cast<Slot*>(slot_task)->post_time;
+    }
+
+    Location TaskSlotTable::LocationOf(Task* slot_task)
+    {
+        return static_cast<Slot*>(slot_task)->from_here;
+    }
+
+    void TaskSlotTable::SetDelayEntry(Task* slot_task, void* entry)
+    {
+        static_cast<Slot*>(slot_task)->delay_entry.store(entry, std::memory_order_relaxed);
+    }
+
+    void* TaskSlotTable::TakeDelayEntry(Task* slot_task, unsigned long long generation)
+    {
+        Slot* slot = static_cast<Slot*>(slot_task);
+        if (slot->state.load(std::memory_order_acquire) != MakeState(generation, STATUS_CANCELLED))
+            return 0;
+
+        return slot->delay_entry.exchange(0, std::memory_order_relaxed);
+    }
+
+    void TaskSlotTable::SetTraceId(Task* slot_task, unsigned long long trace_id)
+    {
+        static_cast<Slot*>(slot_task)->trace_id = trace_id;
+    }
+
+    unsigned long long TaskSlotTable::TraceIdOf(Task* slot_task)
+    {
+        return static_cast<Slot*>(slot_task)->trace_id;
+    }
+
+    TaskSlotTable::Slot* TaskSlotTable::Alloc()
+    {
+        // the upper half of free_head_ is an ABA tag, the lower half is index + 1
+        unsigned long long head = free_head_.load(std::memory_order_acquire);
+        while (head & 0xffffffffULL)
+        {
+            Slot* slot = At((unsigned int)(head & 0xffffffffULL) - 1);
+            unsigned long long next = ((head >> 32) + 1) << 32 |
+                                      slot->next_free.load(std::memory_order_relaxed);
+            if (free_head_.compare_exchange_weak(head, next, std::memory_order_acq_rel))
+                return slot;
+        }
+
+        unsigned int index = size_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= kChunkSize * kMaxChunks)
+            return 0;
+
+        std::atomic<Slot*>& chunk = chunks_[index >> kChunkBits];
+        Slot* slots = chunk.load(std::memory_order_acquire);
+        if (!slots)
+        {
+            Slot* fresh = new Slot[kChunkSize];
+            unsigned int first = index & ~(kChunkSize - 1);
+            for (unsigned int i = 0; i < kChunkSize; ++i)
+            {
+                fresh[i].table = this;
+                fresh[i].index = first + i;
+            }
+
+            if (chunk.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel))
+                slots = fresh;
+            else
+                delete [] fresh;
+        }
+
+        return &slots[index & (kChunkSize - 1)];
+    }
+
+    void TaskSlotTable::Release(Slot* slot)
+    {
+        unsigned long long generation = slot->state.load(std::memory_order_relaxed) >> kStatusBits;
+        slot->state.store(MakeState(generation + 1, STATUS_FREE), std::memory_order_release);
+
+        unsigned long long head = free_head_.load(std::memory_order_relaxed);
+        unsigned long long next;
+        do
+        {
+            slot->next_free.store((unsigned int)(head & 0xffffffffULL), std::memory_order_relaxed);
+            next = ((head >> 32) + 1) << 32 | (slot->index + 1);
+        } while (!free_head_.compare_exchange_weak(head, next, std::memory_order_acq_rel));
+    }
+
+    TaskSlotTable::Slot* TaskSlotTable::At(unsigned int index) const
+    {
+        if (index >= kChunkSize * kMaxChunks)
+            return 0;
+
+        Slot* slots = chunks_[index >> kChunkBits].load(std::memory_order_acquire);
+        if (!slots)
+            return 0;
+
+        return &slots[index & (kChunkSize - 1)];
+    }
+
+    unsigned long long TaskSlotTable::MakeState(unsigned long long generation, Status status)
+    {
+        return (generation << kStatusBits) | status;
+    }
+
+    void TaskSlotTable::DropTask(Slot* slot, Task* task)
+    {
+        if (slot->intrusive)
+            static_cast<IntrusiveTask*>(task)->Abandon();
+        else
+            delete task;
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef __base_task_handle_h__
+#define __base_task_handle_h__
+
+#include "base/def.h"
+#include "base/location.h"
+#include "base/task.h"
+#include "base/time_ticks.h"
+
+#include <atomic>
+
+namespace base
+{
+    class TaskSlotTable;
+
+    /*
+     * Returned by TaskCenter::PostTask/PostDelayTask. Copyable and
+     * generation counted, so cancelling a task that has already run, or
+     * whose slot was reused, is a harmless no-op. It must not outlive
+     * the TaskCenter that returned it. The generation is 62 bits, so a
+     * stale handle could only hit a reused slot after 2^62 posts through
+     * that one slot, tens of thousands of years at 5M posts per second.
+     */
+    class TaskHandle
+    {
+    public:
+        TaskHandle();
+
+        // Drops the task and deletes it right away if it has not started;
+        // a delayed task also leaves its center's delay queue at once.
+        // Returns false if it already ran, is running, or was cancelled.
+        bool Cancel();
+
+        bool IsValid() const;
+
+        // What a post dropped under OVERFLOW_DROP_NEWEST returns: invalid
+        // like a failed post's, but the task is already deleted.
+        static TaskHandle Dropped();
+        bool IsDropped() const;
+
+        typedef unsigned int TaskHandle::*SafeBool;
+        operator SafeBool() const
+        {
+            return IsValid() ? &TaskHandle::index_ : 0;
+        }
+
+    private:
+        friend class TaskSlotTable;
+
+        TaskHandle(TaskSlotTable* table, unsigned int index, unsigned long long generation);
+
+        static const unsigned int kDroppedIndex = ~0u;
+
+        TaskSlotTable*     table_;
+        unsigned int       index_;
+        unsigned long long generation_;
+    };
+
+    /*
+     * Generation-counted slots backing TaskHandle. Wrap() hands out a
+     * slot task that stands in for the posted task inside the queues; a
+     * cancelled slot stays queued as a tombstone holding no task and is
+     * recycled when the queue reaches it. Slot allocation is a lock-free
+     * index stack, so posting stays lock-free.
+     */
+    class TaskSlotTable
+    {
+    public:
+        // Told of a cancelled slot that has a delay entry set, so the delay
+        // queue holding it can drop it, see TakeDelayEntry.
+        typedef void (*CancelHook)(void* context, Task* slot_task, unsigned long long generation);
+
+        TaskSlotTable();
+        ~TaskSlotTable();
+
+        // Only before the first Wrap().
+        void SetCancelHook(CancelHook hook, void* context);
+
+        // Returns the slot task to queue in place of |task|, or 0 when
+        // the table is full.
+        Task* Wrap(Task* task, TaskHandle* handle);
+        Task* WrapIntrusive(IntrusiveTask* task, TaskHandle* handle);
+
+        bool Cancel(unsigned int index, unsigned long long generation);
+
+        // Drops a queued slot task without running it.
+        static void Discard(Task* slot_task);
+
+        // A cancelled slot, which a consumer may Discard instead of running.
+        static bool IsCancelled(Task* slot_task);
+
+        // Where and when a slot task was posted, kept for TaskCenter
+        // metrics. Both are null unless set after Wrap().
+        static void      SetPostInfo(Task* slot_task, const TimeTicks& post_time, const Location& from_here);
+        static TimeTicks PostTimeOf(Task* slot_task);
+        static Location  LocationOf(Task* slot_task);
+
+        // The slot's entry in a delay queue, set and cleared under the
+        // queue's lock. TakeDelayEntry returns and clears it only while
+        // the slot is still cancelled at generation, so a hook that runs
+        // after the slot was popped or reused leaves it alone.
+        static void  SetDelayEntry(Task* slot_task, void* entry);
+        static void* TakeDelayEntry(Task* slot_task, unsigned long long generation);
+
+        // Flow id linking the post of a slot task to its run in a trace,
+        // 0 unless set after Wrap().
+        static void               SetTraceId(Task* slot_task, unsigned long long trace_id);
+        static unsigned long long TraceIdOf(Task* slot_task);
+
+    private:
+        enum Status
+        {
+            STATUS_FREE      = 0,
+            STATUS_PENDING   = 1,
+            STATUS_RUNNING   = 2,
+            STATUS_CANCELLED = 3
+        };
+
+        class Slot : public Task
+        {
+        public:
+            Slot();
+
+            virtual void Run();
+
+            TaskSlotTable*                  table;
+            unsigned int                    index;
+            std::atomic<Task*>              task;
+            std::atomic<unsigned long long> state;
+            std::atomic<unsigned int>       next_free;
+            std::atomic<void*>              delay_entry;
+            bool                            intrusive;
+            TimeTicks                       post_time;
+            Location                        from_here;
+            unsigned long long              trace_id;
+        };
+
+        static const unsigned int kChunkBits = 12;
+        static const unsigned int kChunkSize = 1u << kChunkBits;
+        static const unsigned int kMaxChunks = 4096;
+        // state is generation << kStatusBits | status, the generation bumped
+        // on every release; the LIFO free stack hands one hot slot out over
+        // and over, so it gets the 62 bits of a 64-bit word
+        static const unsigned int kStatusBits = 2;
+        static const unsigned int kStatusMask = (1u << kStatusBits) - 1;
+
+        Task* WrapTask(Task* task, bool intrusive, TaskHandle* handle);
+        Slot* Alloc();
+        void  Release(Slot* slot);
+        Slot* At(unsigned int index) const;
+
+        static unsigned long long MakeState(unsigned long long generation, Status status);
+        static void         DropTask(Slot* slot, Task* task);
+
+    private:
+        std::atomic<Slot*>              chunks_[kMaxChunks];
+        std::atomic<unsigned int>       size_;
+        std::atomic<unsigned long long> free_head_;
+        CancelHook                      cancel_hook_;
+        void*                           cancel_context_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(TaskSlotTable)
+    };
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "task_metrics.h"
+
+namespace base
+{
+    // the recording thread is the only writer of a site
+    static inline void AddTo(std::atomic<long long>* total, long long value)
+    {
+        total->store(total->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static inline void MaxTo(std::atomic<long long>* max, long long value)
+    {
+        if (value > max->load(std::memory_order_relaxed))
+            max->store(value, std::memory_order_relaxed);
+    }
+
+    TaskMetricsSnapshot::TaskMetricsSnapshot()
+        : busy_ns(0)
+        , idle_ns(0) {}
+
+    double TaskMetricsSnapshot::BusyRatio() const
+    {
+        long long total = busy_ns + idle_ns;
+        return total > 0 ? (double)busy_ns / total : 0.0;
+    }
+
+    TaskMetrics::TaskMetrics()
+        : busy_ns_(0)
+        , start_time_(TimeTicks::Now())
+    {
+        for (int i = 0; i < kMaxSites; ++i)
+        {
+            Site& site = sites_[i];
+            site.file.store(0, std::memory_order_relaxed);
+            site.line.store(0, std::memory_order_relaxed);
+            site.count.store(0, std::memory_order_relaxed);
+            site.total_wait_ns.store(0, std::memory_order_relaxed);
+            site.max_wait_ns.store(0, std::memory_order_relaxed);
+            site.total_run_ns.store(0, std::memory_order_relaxed);
+            site.max_run_ns.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void TaskMetrics::RecordTask(const TimeDelta& queue_wait, const TimeDelta& run_time, const Location& from_here)
+    {
+        queue_wait_.Add(queue_wait.InNanoseconds());
+        run_time_.Add(run_time.InNanoseconds());
+        RecordSite(from_here, queue_wait.InNanoseconds(), run_time.InNanoseconds());
+    }
+
+    void TaskMetrics::RecordDelayTask(const TimeDelta& lateness, const TimeDelta& run_time, const Location& from_here)
+    {
+        delay_lateness_.Add(lateness.InNanoseconds());
+        run_time_.Add(run_time.InNanoseconds());
+        RecordSite(from_here, lateness.InNanoseconds(), run_time.InNanoseconds());
+    }
+
+    void TaskMetrics::RecordQueueDepth(long depth)
+    {
+        queue_depth_.Add(depth);
+    }
+
+    void TaskMetrics::RecordBusy(const TimeDelta& busy)
+    {
+        AddTo(&busy_ns_, busy.InNanoseconds());
+    }
+
+    void TaskMetrics::Snapshot(TaskMetricsSnapshot* snapshot) const
+    {
+        queue_wait_.Snapshot(&snapshot->queue_wait);
+        run_time_.Snapshot(&snapshot->run_time);
+        queue_depth_.Snapshot(&snapshot->queue_depth);
+        delay_lateness_.Snapshot(&snapshot->delay_lateness);
+
+        long long elapsed = (TimeTicks::Now() - start_time_).InNanoseconds();
+        snapshot->busy_ns = busy_ns_.load(std::memory_order_relaxed);
+        snapshot->idle_ns = elapsed > snapshot->busy_ns ? elapsed - snapshot->busy_ns : 0;
+
+        snapshot->sites.clear();
+        for (int i = 0; i < kMaxSites; ++i)
+        {
+            const Site& site = sites_[i];
+            const char* file = site.file.load(std::memory_order_acquire);
+            if (!file)
+                continue;
+
+            TaskSiteStats stats;
+            stats.from_here = Location(file, site.line.load(std::memory_order_relaxed));
+            stats.count = site.count.load(std::memory_order_relaxed);
+            stats.total_wait_ns = site.total_wait_ns.load(std::memory_order_relaxed);
+            stats.max_wait_ns = site.max_wait_ns.load(std::memory_order_relaxed);
+            stats.total_run_ns = site.total_run_ns.load(std::memory_order_relaxed);
+            stats.max_run_ns = site.max_run_ns.load(std::memory_order_relaxed);
+            snapshot->sites.push_back(stats);
+        }
+    }
+
+    void TaskMetrics::RecordSite(const Location& from_here, long long wait_ns, long long run_ns)
+    {
+        if (from_here.is_null())
+            return;
+
+        Site* site = FindSite(from_here);
+        if (!site)
+            return;
+
+        AddTo(&site->count, 1);
+        AddTo(&site->total_wait_ns, wait_ns);
+        MaxTo(&site->max_wait_ns, wait_ns);
+        AddTo(&site->total_run_ns, run_ns);
+        MaxTo(&site->max_run_ns, run_ns);
+    }
+
+    TaskMetrics::Site* TaskMetrics::FindSite(const Location& from_here)
+    {
+        // open addressing on the file literal's address and the line
+        unsigned long long key = (unsigned long long)(size_t)from_here.file ^
+                                 ((unsigned long long)from_here.line * 0x9e3779b97f4a7c15ULL);
+        unsigned int index = (unsigned int)(key ^ (key >> 29)) % kMaxSites;
+
+        for (int probe = 0; probe < kMaxSites; ++probe)
+        {
+            Site& site = sites_[(index + probe) % kMaxSites];
+            const char* file = site.file.load(std::memory_order_relaxed);
+            if (!file)
+            {
+                // publish the line before the file that marks the site used
+                site.line.store(from_here.line, std::memory_order_relaxed);
+                site.file.store(from_here.file, std::memory_order_release);
+                return &site;
+            }
+
+            if (file == from_here.file && site.line.load(std::memory_order_relaxed) == from_here.line)
+                return &site;
+        }
+
+        return 0;
+    }
+}
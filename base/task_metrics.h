@@ -0,0 +1,91 @@
+#ifndef __base_task_metrics_h__
+#define __base_task_metrics_h__
+
+#include "base/def.h"
+#include "base/histogram.h"
+#include "base/location.h"
+#include "base/time_ticks.h"
+
+#include <atomic>
+#include <vector>
+
+namespace base
+{
+    // Totals for the tasks posted from one FROM_HERE. Wait is the queue
+    // wait of a task, or the lateness of a delayed one.
+    struct TaskSiteStats
+    {
+        Location  from_here;
+        long long count;
+        long long total_wait_ns;
+        long long max_wait_ns;
+        long long total_run_ns;
+        long long max_run_ns;
+    };
+
+    struct TaskMetricsSnapshot
+    {
+        TaskMetricsSnapshot();
+
+        // share of the time since EnableMetrics() spent running work
+        double BusyRatio() const;
+
+        HistogramSnapshot          queue_wait;     // ns, post to start
+        HistogramSnapshot          run_time;       // ns
+        HistogramSnapshot          queue_depth;    // tasks, sampled per batch
+        HistogramSnapshot          delay_lateness; // ns, due time to start
+        long long                  busy_ns;
+        long long                  idle_ns;
+        std::vector<TaskSiteStats> sites;
+    };
+
+    /*
+     * What a TaskCenter records about its own work once metrics are
+     * enabled. Only the center's thread records, anyone may Snapshot().
+     * Tasks posted with a Location are also totalled per posting site,
+     * for up to kMaxSites distinct sites.
+     */
+    class TaskMetrics
+    {
+    public:
+        TaskMetrics();
+
+        void RecordTask(const TimeDelta& queue_wait, const TimeDelta& run_time, const Location& from_here);
+        void RecordDelayTask(const TimeDelta& lateness, const TimeDelta& run_time, const Location& from_here);
+        void RecordQueueDepth(long depth);
+        void RecordBusy(const TimeDelta& busy);
+
+        void Snapshot(TaskMetricsSnapshot* snapshot) const;
+
+        static const int kMaxSites = 256;
+
+    private:
+        struct Site
+        {
+            std::atomic<const char*> file;
+            std::atomic<int>         line;
+            std::atomic<long long>   count;
+            std::atomic<long long>   total_wait_ns;
+            std::atomic<long long>   max_wait_ns;
+            std::atomic<long long>   total_run_ns;
+            std::atomic<long long>   max_run_ns;
+        };
+
+        void  RecordSite(const Location& from_here, long long wait_ns, long long run_ns);
+        Site* FindSite(const Location& from_here);
+
+    private:
+        Histogram              queue_wait_;
+        Histogram              run_time_;
+        Histogram              queue_depth_;
+        Histogram              delay_lateness_;
+        std::atomic<long long> busy_ns_;
+        TimeTicks              start_time_;
+        Site                   sites_[kMaxSites];
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(TaskMetrics)
+    };
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include "task_queue_limit.h"
+#include "futex.h"
+
+namespace base
+{
+    TaskQueueLimit::TaskQueueLimit()
+        : capacity_(0)
+        , policy_(OVERFLOW_REJECT)
+        , high_watermark_(0)
+        , low_watermark_(0)
+        , observer_(0)
+        , depth_(0)
+        , above_high_(false)
+        , closed_(false)
+        , blocked_(0)
+        , room_sequence_(0) {}
+
+    void TaskQueueLimit::SetCapacity(long capacity, QueueOverflowPolicy policy, const TimeDelta& block_timeout)
+    {
+        capacity_ = capacity > 0 ? capacity : 0;
+        policy_ = policy;
+        block_timeout_ = block_timeout;
+    }
+
+    void TaskQueueLimit::SetWatermarks(long high, long low, QueueWatermarkObserver* observer)
+    {
+        high_watermark_ = high;
+        low_watermark_ = low < high ? low : high;
+        observer_ = high > 0 ? observer : 0;
+    }
+
+    TaskQueueLimit::Admission TaskQueueLimit::Acquire(bool may_block)
+    {
+        long depth = 0;
+        if (!TryReserve(&depth))
+        {
+            switch (policy_)
+            {
+            case OVERFLOW_DROP_OLDEST:
+                return ADMIT_DROP_OLDEST;
+
+            case OVERFLOW_DROP_NEWEST:
+                return DROP_NEWEST;
+
+            case OVERFLOW_BLOCK:
+            {
+                if (!may_block)
+                    return REJECT;
+
+                TimeTicks deadline;
+                if (block_timeout_ != TimeDelta())
+                    deadline = TimeTicks::Now() + block_timeout_;
+
+                if (WaitForRoom(deadline, &depth))
+                    break;
+
+                return REJECT;
+            }
+
+            default:
+                return REJECT;
+            }
+        }
+
+        if (observer_ && depth >= high_watermark_ &&
+            !above_high_.load(std::memory_order_relaxed) &&
+            !above_high_.exchange(true))
+        {
+            observer_->OnHighWatermark(depth);
+
+            // A Release that drained to the low watermark after depth was
+            // read but before the exchange saw above_high_ still clear and
+            // stayed silent, so look at the depth again. Both sides store
+            // then load in sequential order: either that Release sees the
+            // flag or this sees its depth.
+            long now = depth_.load();
+            if (now <= low_watermark_)
+                ReportLowWatermark(now);
+        }
+
+        return ADMIT;
+    }
+
+    void TaskQueueLimit::Release()
+    {
+        // pairs with the blocked_ increment in WaitForRoom: either the
+        // waiter sees this room, or this sees the waiter
+        long depth = depth_.fetch_sub(1) - 1;
+        if (blocked_.load() > 0)
+        {
+            room_sequence_.fetch_add(1);
+            FutexWakeAll(&room_sequence_);
+        }
+
+        if (observer_ && depth <= low_watermark_)
+            ReportLowWatermark(depth);
+    }
+
+    void TaskQueueLimit::Close()
+    {
+        closed_.store(true);
+        room_sequence_.fetch_add(1);
+        FutexWakeAll(&room_sequence_);
+    }
+
+    void TaskQueueLimit::ReportLowWatermark(long depth)
+    {
+        // the exchange makes sure only one of Release and Acquire reports
+        if (above_high_.load() && above_high_.exchange(false))
+            observer_->OnLowWatermark(depth);
+    }
+
+    bool TaskQueueLimit::TryReserve(long* depth)
+    {
+        if (capacity_ == 0)
+        {
+            *depth = depth_.fetch_add(1) + 1;
+            return true;
+        }
+
+        long current = depth_.load();
+        while (current < capacity_)
+        {
+            if (depth_.compare_exchange_weak(current, current + 1))
+            {
+                *depth = current + 1;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool TaskQueueLimit::WaitForRoom(const TimeTicks& deadline, long* depth)
+    {
+        while (!closed_.load())
+        {
+            // a Release after this read changes the word, so the wait
+            // below cannot miss it
+            int sequence = room_sequence_.load();
+            blocked_.fetch_add(1);
+
+            if (TryReserve(depth))
+            {
+                blocked_.fetch_sub(1);
+                return true;
+            }
+
+            if (!deadline.is_null() && TimeTicks::Now() >= deadline)
+            {
+                blocked_.fetch_sub(1);
+                return false;
+            }
+
+            FutexWait(&room_sequence_, sequence, deadline);
+            blocked_.fetch_sub(1);
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef __base_task_queue_limit_h__
+#define __base_task_queue_limit_h__
+
+#include "base/def.h"
+#include "base/time_ticks.h"
+
+#include <atomic>
+
+namespace base
+{
+    // What a post to a full TaskCenter queue does.
+    enum QueueOverflowPolicy
+    {
+        OVERFLOW_BLOCK       = 0,  // wait for room, failing like REJECT on timeout
+        OVERFLOW_REJECT      = 1,  // fail the post, the task stays the caller's
+        OVERFLOW_DROP_OLDEST = 2,  // discard the oldest task of the least urgent level
+        OVERFLOW_DROP_NEWEST = 3   // discard the task being posted
+    };
+
+    /*
+     * Told when a queue fills up to its high watermark and again when it
+     * drains back to the low one, so producers can shed load early.
+     * OnHighWatermark runs on the posting thread, OnLowWatermark on the
+     * thread running the center, or on the posting thread when the queue
+     * drained while that post was reporting the high watermark; both must
+     * be quick and thread safe.
+     */
+    class QueueWatermarkObserver
+    {
+    public:
+        virtual ~QueueWatermarkObserver() {}
+
+        virtual void OnHighWatermark(long depth) = 0;
+        virtual void OnLowWatermark(long depth) = 0;
+    };
+
+    /*
+     * The depth count behind a bounded or watched TaskCenter queue.
+     * Producers reserve a place with Acquire() before queueing a task,
+     * the consumer gives it back with Release() once the task leaves the
+     * queue. Blocked producers sleep on a futex word the consumer only
+     * touches while someone is waiting.
+     */
+    class TaskQueueLimit
+    {
+    public:
+        enum Admission
+        {
+            ADMIT,             // a place is reserved
+            ADMIT_DROP_OLDEST, // full; admit after dropping a queued task
+            DROP_NEWEST,       // full; discard the posted task
+            REJECT             // full, timed out or stopped; fail the post
+        };
+
+        TaskQueueLimit();
+
+        // capacity 0 is unbounded; a null block_timeout blocks until there
+        // is room or the limit is closed
+        void SetCapacity(long capacity, QueueOverflowPolicy policy, const TimeDelta& block_timeout);
+        void SetWatermarks(long high, long low, QueueWatermarkObserver* observer);
+
+        // whether posts have to go through Acquire() at all
+        bool IsActive() const
+        {
+            return capacity_ > 0 || observer_ != 0;
+        }
+
+        QueueOverflowPolicy policy() const
+        {
+            return policy_;
+        }
+
+        // may_block false turns OVERFLOW_BLOCK into a rejection
+        Admission Acquire(bool may_block = true);
+        void      Release();
+
+        // Fails every post from now on and wakes the blocked ones.
+        void Close();
+
+    private:
+        void ReportLowWatermark(long depth);
+        bool TryReserve(long* depth);
+        bool WaitForRoom(const TimeTicks& deadline, long* depth);
+
+    private:
+        long                    capacity_;
+        QueueOverflowPolicy     policy_;
+        TimeDelta               block_timeout_;
+        long                    high_watermark_;
+        long                    low_watermark_;
+        QueueWatermarkObserver* observer_;
+
+        std::atomic<long>       depth_;
+        std::atomic<bool>       above_high_;
+        std::atomic<bool>       closed_;
+        std::atomic<int>        blocked_;
+        std::atomic<int>        room_sequence_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(TaskQueueLimit)
+    };
+}
+
+#endif
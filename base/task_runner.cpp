@@ -0,0 +1,37 @@
+#include "task_runner.h"
+
+namespace base
+{
+    THREAD_LOCAL void*                   TaskRunner::current_center_ = 0;
+    THREAD_LOCAL const TaskRunner::Ops*  TaskRunner::current_ops_ = 0;
+
+    TaskHandle TaskRunner::PostTask(Task* task, TaskPriority priority) const
+    {
+        return PostTask(Location(), task, priority);
+    }
+
+    TaskHandle TaskRunner::PostTask(const Location& from_here, Task* task, TaskPriority priority) const
+    {
+        if (!center_)
+        {
+            return TaskHandle();
+        }
+
+        return ops_->post_task(center_, from_here, task, priority);
+    }
+
+    TaskHandle TaskRunner::PostDelayTask(Task* task, const TimeDelta& delay) const
+    {
+        return PostDelayTask(Location(), task, delay);
+    }
+
+    TaskHandle TaskRunner::PostDelayTask(const Location& from_here, Task* task, const TimeDelta& delay) const
+    {
+        if (!center_)
+        {
+            return TaskHandle();
+        }
+
+        return ops_->post_delay_task(center_, from_here, task, delay);
+    }
+}
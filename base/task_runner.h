@@ -0,0 +1,118 @@
+#ifndef __base_task_runner_h__
+#define __base_task_runner_h__
+
+#include "base/def.h"
+#include "base/location.h"
+#include "base/task.h"
+#include "base/task_handle.h"
+#include "base/time_ticks.h"
+
+namespace base
+{
+    /*
+     * A handle on a TaskCenter with the center's type erased, so code
+     * that only posts need not be a template over the pump. It is two
+     * pointers, the center and a static table of its post functions,
+     * and is copied freely. It does not own the center and must not be
+     * used once the center is destroyed.
+     */
+    class TaskRunner
+    {
+    public:
+        struct Ops
+        {
+            TaskHandle (*post_task)(void* center, const Location& from_here, Task* task, TaskPriority priority);
+            TaskHandle (*post_delay_task)(void* center, const Location& from_here, Task* task, const TimeDelta& delay);
+        };
+
+        TaskRunner()
+            : center_(0), ops_(0)
+        {
+        }
+
+        TaskRunner(void* center, const Ops* ops)
+            : center_(center), ops_(ops)
+        {
+        }
+
+        bool IsValid() const
+        {
+            return center_ != 0;
+        }
+
+        // Same contract as the center's own PostTask and PostDelayTask; an
+        // invalid runner fails every post.
+        TaskHandle PostTask(Task* task, TaskPriority priority = PRIORITY_NORMAL) const;
+        TaskHandle PostTask(const Location& from_here, Task* task, TaskPriority priority = PRIORITY_NORMAL) const;
+        TaskHandle PostDelayTask(Task* task, const TimeDelta& delay) const;
+        TaskHandle PostDelayTask(const Location& from_here, Task* task, const TimeDelta& delay) const;
+
+        // true on the thread inside the center's Run()
+        bool RunsTasksOnCurrentThread() const
+        {
+            return center_ != 0 && center_ == current_center_;
+        }
+
+        bool operator==(const TaskRunner& other) const
+        {
+            return center_ == other.center_;
+        }
+
+        bool operator!=(const TaskRunner& other) const
+        {
+            return center_ != other.center_;
+        }
+
+        // The runner of the center running on this thread, invalid on a
+        // thread that runs none. Two thread-local loads.
+        static TaskRunner Current()
+        {
+            return TaskRunner(current_center_, current_ops_);
+        }
+
+        // The center running on this thread if its post table is ops,
+        // how TaskCenter<...>::Current() checks the type.
+        static void* CurrentCenter(const Ops* ops)
+        {
+            return current_ops_ == ops ? current_center_ : 0;
+        }
+
+        /*
+         * Makes a runner current on this thread for the scope, restoring
+         * the previous one after, so a center run from inside another's
+         * task hands the thread back when it quits.
+         */
+        class ScopedCurrent
+        {
+        public:
+            explicit ScopedCurrent(const TaskRunner& runner)
+                : previous_center_(current_center_), previous_ops_(current_ops_)
+            {
+                current_center_ = runner.center_;
+                current_ops_ = runner.ops_;
+            }
+
+            ~ScopedCurrent()
+            {
+                current_center_ = previous_center_;
+                current_ops_ = previous_ops_;
+            }
+
+        private:
+            void*      previous_center_;
+            const Ops* previous_ops_;
+
+        private:
+            DISABLE_COPY_AND_ASSIGN(ScopedCurrent)
+        };
+
+    private:
+        void*      center_;
+        const Ops* ops_;
+
+        static THREAD_LOCAL void*      current_center_;
+        static THREAD_LOCAL const Ops* current_ops_;
+    };
+}
+
+#endif
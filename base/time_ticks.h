@@ -1,26 +1,150 @@
 #ifndef __base_time_ticks_h__
 #define __base_time_ticks_h__
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include <time.h>
+#endif
 
 namespace base
 {
+    /*
+     * A span of time in nanoseconds.
+     */
+    class TimeDelta
+    {
+    public:
+        TimeDelta()
+            : delta_(0) {}
+
+        static TimeDelta FromNanoseconds(long long ns)
+        {
+            return TimeDelta(ns);
+        }
+
+        static TimeDelta FromMicroseconds(long long us)
+        {
+            return TimeDelta(us * 1000LL);
+        }
+
+        static TimeDelta FromMilliseconds(long long ms)
+        {
+            return TimeDelta(ms * 1000000LL);
+        }
+
+        static TimeDelta FromSeconds(long long s)
+        {
+            return TimeDelta(s * 1000000000LL);
+        }
+
+        long long InNanoseconds() const
+        {
+            return delta_;
+        }
+
+        long long InMicroseconds() const
+        {
+            return delta_ / 1000LL;
+        }
+
+        long long InMilliseconds() const
+        {
+            return delta_ / 1000000LL;
+        }
+
+        long long InMillisecondsRoundedUp() const
+        {
+            return (delta_ + 999999LL) / 1000000LL;
+        }
+
+        TimeDelta operator+ (const TimeDelta& other) const { return TimeDelta(delta_ + other.delta_); }
+        TimeDelta operator- (const TimeDelta& other) const { return TimeDelta(delta_ - other.delta_); }
+        TimeDelta& operator+= (const TimeDelta& other) { delta_ += other.delta_; return *this; }
+        TimeDelta& operator-= (const TimeDelta& other) { delta_ -= other.delta_; return *this; }
+
+        bool operator== (const TimeDelta& other) const { return delta_ == other.delta_; }
+        bool operator!= (const TimeDelta& other) const { return delta_ != other.delta_; }
+        bool operator<  (const TimeDelta& other) const { return delta_ <  other.delta_; }
+        bool operator<= (const TimeDelta& other) const { return delta_ <= other.delta_; }
+        bool operator>  (const TimeDelta& other) const { return delta_ >  other.delta_; }
+        bool operator>= (const TimeDelta& other) const { return delta_ >= other.delta_; }
+
+    private:
+        explicit TimeDelta(long long delta)
+            : delta_(delta) {}
+
+        long long delta_;
+    };
+
+    /*
+     * A point on the 64-bit nanosecond monotonic clock: CLOCK_MONOTONIC on
+     * Linux, QueryPerformanceCounter on Windows. Both already read the
+     * invariant TSC through the vDSO/HAL where the hardware allows it. A
+     * null TimeTicks (zero) means "no time".
+     */
     class TimeTicks
     {
     public:
-        TimeTicks(unsigned long ticks)
-            : ticks_(ticks) {}
+        TimeTicks()
+            : ticks_(0) {}
 
-        ~TimeTicks() {}
+        static TimeTicks Now()
+        {
+#if defined(_WIN32)
+            static LONGLONG frequency = 0;
+            if (!frequency)
+            {
+                LARGE_INTEGER value;
+                ::QueryPerformanceFrequency(&value);
+                frequency = value.QuadPart;
+            }
 
-        static int Now()
+            LARGE_INTEGER counter;
+            ::QueryPerformanceCounter(&counter);
+            return TimeTicks(counter.QuadPart / frequency * 1000000000LL +
+                             counter.QuadPart % frequency * 1000000000LL / frequency);
+#else
+            struct timespec ts;
+            ::clock_gettime(CLOCK_MONOTONIC, &ts);
+            return TimeTicks((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+#endif
+        }
+
+        static TimeTicks FromInternalValue(long long ns)
+        {
+            return TimeTicks(ns);
+        }
+
+        // nanoseconds on the monotonic clock
+        long long ToInternalValue() const
         {
-            return (int)::GetTickCount();
+            return ticks_;
         }
 
+        bool is_null() const
+        {
+            return ticks_ == 0;
+        }
+
+        TimeTicks operator+ (const TimeDelta& delta) const { return TimeTicks(ticks_ + delta.InNanoseconds()); }
+        TimeTicks operator- (const TimeDelta& delta) const { return TimeTicks(ticks_ - delta.InNanoseconds()); }
+        TimeDelta operator- (const TimeTicks& other) const { return TimeDelta::FromNanoseconds(ticks_ - other.ticks_); }
+        TimeTicks& operator+= (const TimeDelta& delta) { ticks_ += delta.InNanoseconds(); return *this; }
+
+        bool operator== (const TimeTicks& other) const { return ticks_ == other.ticks_; }
+        bool operator!= (const TimeTicks& other) const { return ticks_ != other.ticks_; }
+        bool operator<  (const TimeTicks& other) const { return ticks_ <  other.ticks_; }
+        bool operator<= (const TimeTicks& other) const { return ticks_ <= other.ticks_; }
+        bool operator>  (const TimeTicks& other) const { return ticks_ >  other.ticks_; }
+        bool operator>= (const TimeTicks& other) const { return ticks_ >= other.ticks_; }
+
     private:
-        int ticks_;
+        explicit TimeTicks(long long ticks)
+            : ticks_(ticks) {}
+
+        long long ticks_;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,304 @@
+#include "timing_wheel.h"
+#include "task_handle.h"
+
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace base
+{
+    static inline int LowestBit(unsigned int word)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, word);
+        return (int)index;
+#else
+        return __builtin_ctz(word);
+#endif
+    }
+
+    TimingWheel::TimingWheel()
+        : free_list_(0)
+        , current_tick_(TimeTicks::Now().ToInternalValue() / kTickNanoseconds)
+        , count_(0)
+    {
+        for (int level = 0; level < kLevels; ++level)
+        {
+            for (int slot = 0; slot < kSlots; ++slot)
+                InitList(&slots_[level][slot]);
+        }
+
+        memset(bitmap_, 0, sizeof(bitmap_));
+        InitList(&expired_);
+    }
+
+    TimingWheel::~TimingWheel()
+    {
+        Clear();
+
+        while (free_list_)
+        {
+            Entry* entry = free_list_;
+            free_list_ = static_cast<Entry*>(entry->next);
+            delete entry;
+        }
+    }
+
+    TimingWheel::Handle TimingWheel::Push(Task* task, const TimeTicks& expire_time)
+    {
+        Entry* entry = AllocEntry();
+        entry->task = task;
+        entry->expire_tick = (expire_time.ToInternalValue() + kTickNanoseconds - 1) / kTickNanoseconds;
+
+        LinkEntry(entry);
+        ++count_;
+
+        return entry;
+    }
+
+    Task* TimingWheel::Remove(Handle handle)
+    {
+        UnlinkEntry(handle);
+        --count_;
+
+        Task* task = handle->task;
+        FreeEntry(handle);
+        return task;
+    }
+
+    Task* TimingWheel::PopExpired(const TimeTicks& now)
+    {
+        Advance(now.ToInternalValue() / kTickNanoseconds);
+
+        if (ListEmpty(&expired_))
+            return 0;
+
+        return Remove(static_cast<Entry*>(expired_.next));
+    }
+
+    TimeTicks TimingWheel::NextExpireTime() const
+    {
+        if (!ListEmpty(&expired_))
+            return TimeTicks::FromInternalValue(current_tick_ * kTickNanoseconds);
+
+        // for entries on the upper levels this is the tick they cascade
+        // down, which is early but never late
+        long long tick = NextEventTick();
+        if (tick < 0)
+            return TimeTicks();
+
+        return TimeTicks::FromInternalValue(tick * kTickNanoseconds);
+    }
+
+    bool TimingWheel::Empty() const
+    {
+        return count_ == 0;
+    }
+
+    void TimingWheel::Clear()
+    {
+        for (int level = 0; level < kLevels; ++level)
+        {
+            for (int slot = 0; slot < kSlots; ++slot)
+            {
+                while (!ListEmpty(&slots_[level][slot]))
+                    TaskSlotTable::Discard(Remove(static_cast<Entry*>(slots_[level][slot].next)));
+            }
+        }
+
+        while (!ListEmpty(&expired_))
+            TaskSlotTable::Discard(Remove(static_cast<Entry*>(expired_.next)));
+    }
+
+    void TimingWheel::Advance(long long now_tick)
+    {
+        while (current_tick_ < now_tick)
+        {
+            // jump over ticks that neither expire nor cascade anything
+            long long next_tick = NextEventTick();
+            if (next_tick < 0 || next_tick > now_tick)
+            {
+                current_tick_ = now_tick;
+                break;
+            }
+
+            current_tick_ = next_tick - 1;
+            Tick();
+        }
+    }
+
+    void TimingWheel::Tick()
+    {
+        ++current_tick_;
+
+        int level = 0;
+        while (level + 1 < kLevels && SlotIndex(current_tick_, level) == 0)
+            ++level;
+
+        for (; level > 0; --level)
+            Cascade(level, SlotIndex(current_tick_, level));
+
+        Expire(SlotIndex(current_tick_, 0));
+    }
+
+    void TimingWheel::Cascade(int level, int slot)
+    {
+        ListNode list;
+        InitList(&list);
+
+        while (!ListEmpty(&slots_[level][slot]))
+        {
+            Entry* entry = static_cast<Entry*>(slots_[level][slot].next);
+            UnlinkEntry(entry);
+            ListAppend(&list, entry);
+        }
+
+        while (!ListEmpty(&list))
+        {
+            Entry* entry = static_cast<Entry*>(list.next);
+            list.next = entry->next;
+            list.next->prev = &list;
+            LinkEntry(entry);
+        }
+    }
+
+    void TimingWheel::Expire(int slot)
+    {
+        while (!ListEmpty(&slots_[0][slot]))
+        {
+            Entry* entry = static_cast<Entry*>(slots_[0][slot].next);
+            UnlinkEntry(entry);
+
+            entry->level = kExpiredLevel;
+            entry->slot = 0;
+            ListAppend(&expired_, entry);
+        }
+    }
+
+    void TimingWheel::LinkEntry(Entry* entry)
+    {
+        // Due already: a timer cascading down onto the tick being processed,
+        // or one pushed for a time gone by. The slot of current_tick_ has
+        // been or is about to be swept, and a tick later would be late.
+        long long expire_tick = entry->expire_tick;
+        if (expire_tick <= current_tick_)
+        {
+            entry->level = kExpiredLevel;
+            entry->slot = 0;
+            ListAppend(&expired_, entry);
+            return;
+        }
+
+        long long delta = expire_tick - current_tick_;
+        int level = 0;
+        while (level + 1 < kLevels && delta >= (1LL << (kSlotBits * (level + 1))))
+            ++level;
+
+        // beyond the wheel's range, park in the last slot reachable and
+        // let the cascade put it back with its real expire tick
+        if (delta >= (1LL << (kSlotBits * kLevels)))
+            expire_tick = current_tick_ + (1LL << (kSlotBits * kLevels)) - 1;
+
+        int slot = SlotIndex(expire_tick, level);
+        entry->level = (short)level;
+        entry->slot = (short)slot;
+
+        ListAppend(&slots_[level][slot], entry);
+        bitmap_[level][slot >> 5] |= (1u << (slot & 31));
+    }
+
+    void TimingWheel::UnlinkEntry(Entry* entry)
+    {
+        entry->prev->next = entry->next;
+        entry->next->prev = entry->prev;
+
+        if (entry->level != kExpiredLevel &&
+            ListEmpty(&slots_[entry->level][entry->slot]))
+        {
+            bitmap_[entry->level][entry->slot >> 5] &= ~(1u << (entry->slot & 31));
+        }
+    }
+
+    long long TimingWheel::NextEventTick() const
+    {
+        long long next_tick = -1;
+
+        for (int level = 0; level < kLevels; ++level)
+        {
+            long long base = current_tick_ >> (kSlotBits * level);
+            int distance = FindNextSlot(level, (int)((base + 1) & kSlotMask));
+            if (distance < 0)
+                continue;
+
+            long long tick = (base + 1 + distance) << (kSlotBits * level);
+            if (next_tick < 0 || tick < next_tick)
+                next_tick = tick;
+        }
+
+        return next_tick;
+    }
+
+    int TimingWheel::FindNextSlot(int level, int start) const
+    {
+        int word = start >> 5;
+        unsigned int bits = bitmap_[level][word] & (~0u << (start & 31));
+
+        // one extra word wraps round to the bits below start
+        for (int i = 0; i <= kBitmapWords; ++i)
+        {
+            if (bits)
+            {
+                int slot = (word << 5) + LowestBit(bits);
+                return (slot - start) & kSlotMask;
+            }
+
+            word = (word + 1) % kBitmapWords;
+            bits = bitmap_[level][word];
+        }
+
+        return -1;
+    }
+
+    TimingWheel::Entry* TimingWheel::AllocEntry()
+    {
+        if (!free_list_)
+            return new Entry;
+
+        Entry* entry = free_list_;
+        free_list_ = static_cast<Entry*>(entry->next);
+        return entry;
+    }
+
+    void TimingWheel::FreeEntry(Entry* entry)
+    {
+        entry->next = free_list_;
+        free_list_ = entry;
+    }
+
+    int TimingWheel::SlotIndex(long long tick, int level)
+    {
+        return (int)((tick >> (kSlotBits * level)) & kSlotMask);
+    }
+
+    void TimingWheel::InitList(ListNode* list)
+    {
+        list->prev = list;
+        list->next = list;
+    }
+
+    bool TimingWheel::ListEmpty(const ListNode* list)
+    {
+        return list->next == list;
+    }
+
+    void TimingWheel::ListAppend(ListNode* list, ListNode* link)
+    {
+        link->prev = list->prev;
+        link->next = list;
+        list->prev->next = link;
+        list->prev = link;
+    }
+}
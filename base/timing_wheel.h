@@ -0,0 +1,91 @@
+#ifndef __base_timing_wheel_h__
+#define __base_timing_wheel_h__
+
+#include "base/def.h"
+#include "base/task.h"
+#include "base/time_ticks.h"
+
+namespace base
+{
+    /*
+     * Hierarchical timing wheel for delayed tasks: 4 levels of 256 slots
+     * at 1 ms resolution, covering 2^32 ms. Push and Remove are O(1), and
+     * a slot is expired or cascaded as a whole when its tick comes round.
+     * It can replace DelayTaskQueue as the DelayQueue of TaskCenter;
+     * expire times are rounded up to the next tick. As there, tasks are
+     * slot tasks, discarded through TaskSlotTable by Clear(). Remove()
+     * unlinks the entry at once and returns its task, which is how
+     * TaskCenter drops a cancelled delayed task.
+     */
+    class TimingWheel
+    {
+    private:
+        struct ListNode
+        {
+            ListNode* prev;
+            ListNode* next;
+        };
+
+        struct Entry : public ListNode
+        {
+            Task*     task;
+            long long expire_tick;
+            short     level;
+            short     slot;
+        };
+
+    public:
+        typedef Entry* Handle;
+
+        TimingWheel();
+        ~TimingWheel();
+
+        Handle    Push(Task* task, const TimeTicks& expire_time);
+        Task*     Remove(Handle handle);
+        Task*     PopExpired(const TimeTicks& now);
+        TimeTicks NextExpireTime() const;
+        bool      Empty() const;
+        void      Clear();
+
+    private:
+        static const int kLevels = 4;
+        static const int kSlotBits = 8;
+        static const int kSlots = 1 << kSlotBits;
+        static const int kSlotMask = kSlots - 1;
+        static const int kBitmapWords = kSlots / 32;
+        static const int kExpiredLevel = -1;
+        static const long long kTickNanoseconds = 1000000;
+
+        void Advance(long long now_tick);
+        void Tick();
+        void Cascade(int level, int slot);
+        void Expire(int slot);
+
+        void LinkEntry(Entry* entry);
+        void UnlinkEntry(Entry* entry);
+
+        long long NextEventTick() const;
+        int       FindNextSlot(int level, int start) const;
+
+        Entry* AllocEntry();
+        void   FreeEntry(Entry* entry);
+
+        static int  SlotIndex(long long tick, int level);
+        static void InitList(ListNode* list);
+        static bool ListEmpty(const ListNode* list);
+        static void ListAppend(ListNode* list, ListNode* link);
+
+    private:
+        ListNode     slots_[kLevels][kSlots];
+        unsigned int bitmap_[kLevels][kBitmapWords];
+        ListNode     expired_;
+        Entry*       free_list_;
+        long long    current_tick_;
+        long long    count_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(TimingWheel)
+    };
+}
+
+#endif
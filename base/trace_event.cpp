@@ -0,0 +1,334 @@
+#include "trace_event.h"
+#include "locker.h"
+#include "singleton.h"
+#include "time_ticks.h"
+
+#include <string.h>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace base
+{
+    struct TraceEvent
+    {
+        long long          ts;
+        unsigned long long id;
+        const char*        category;
+        const char*        name;
+        const char*        file;
+        int                line;
+        char               phase;
+    };
+
+    /*
+     * The events of one thread. Only that thread writes; an event is
+     * filled in before written is bumped past it, and a reader drops
+     * whatever the writer may have lapped while it was copying. A buffer
+     * is handed on to a new thread once its own has exited and the
+     * events were dumped; written keeps counting, and first marks where
+     * the new thread's events start.
+     */
+    class TraceBuffer
+    {
+    public:
+        TraceBuffer()
+            : written(0), first(0), free(false), next(0), next_free(0)
+        {
+            Reset();
+        }
+
+        // makes the buffer the calling thread's
+        void Reset()
+        {
+            first.store(written.load(std::memory_order_relaxed), std::memory_order_release);
+            thread_name[0] = 0;
+#if defined(_WIN32)
+            thread_id = ::GetCurrentThreadId();
+#elif defined(__linux__)
+            thread_id = (unsigned long long)::syscall(SYS_gettid);
+#else
+            thread_id = (unsigned long long)::pthread_self();
+#endif
+        }
+
+        void Add(char phase, const char* category, const char* name,
+                 unsigned long long id, const Location& from_here)
+        {
+            unsigned long long index = written.load(std::memory_order_relaxed);
+            TraceEvent& event = events[index & (TraceLog::kEventsPerThread - 1)];
+            event.ts = TimeTicks::Now().ToInternalValue();
+            event.id = id;
+            event.category = category;
+            event.name = name;
+            event.file = from_here.file;
+            event.line = from_here.line;
+            event.phase = phase;
+            written.store(index + 1, std::memory_order_release);
+        }
+
+        void Copy(std::vector<TraceEvent>* out) const
+        {
+            unsigned long long end = written.load(std::memory_order_acquire);
+            unsigned long long begin = end > TraceLog::kEventsPerThread ? end - TraceLog::kEventsPerThread : 0;
+            unsigned long long start = first.load(std::memory_order_acquire);
+            if (begin < start)
+                begin = start;
+
+            out->clear();
+            for (unsigned long long i = begin; i < end; ++i)
+                out->push_back(events[i & (TraceLog::kEventsPerThread - 1)]);
+
+            // the slot of event |after| may be half rewritten too
+            unsigned long long after = written.load(std::memory_order_acquire) + 1;
+            if (after > begin && after - begin > TraceLog::kEventsPerThread)
+            {
+                size_t lapped = (size_t)(after - begin - TraceLog::kEventsPerThread);
+                out->erase(out->begin(), out->begin() + (lapped < out->size() ? lapped : out->size()));
+            }
+        }
+
+        TraceEvent                      events[TraceLog::kEventsPerThread];
+        std::atomic<unsigned long long> written;
+        std::atomic<unsigned long long> first;
+        bool                            free;      // under g_free_locker
+        unsigned long long              thread_id;
+        char                            thread_name[32];
+        TraceBuffer*                    next;
+        TraceBuffer*                    next_free;
+    };
+
+    std::atomic<bool> TraceLog::enabled_(false);
+
+    // Every buffer ever created, newest first. Buffers are never freed.
+    // One whose thread has exited waits in g_exited until the next dump
+    // has its events, then in g_free for a new thread to take it over.
+    static std::atomic<TraceBuffer*>       g_buffers(0);
+    static MultiThreadGuard<CSLocker>      g_free_locker;
+    static TraceBuffer*                    g_exited = 0;
+    static TraceBuffer*                    g_free = 0;
+    static std::atomic<unsigned long long> g_next_flow_id(1);
+    static THREAD_LOCAL TraceBuffer*       g_current_buffer = 0;
+
+    static void OnThreadExit(void* arg)
+    {
+        TraceBuffer* buffer = static_cast<TraceBuffer*>(arg);
+        if (g_current_buffer == buffer)
+            g_current_buffer = 0;
+
+        AutoLocker<CSLocker> guard(&g_free_locker);
+        buffer->next_free = g_exited;
+        g_exited = buffer;
+    }
+
+    static TraceBuffer* AdoptBuffer()
+    {
+        {
+            AutoLocker<CSLocker> guard(&g_free_locker);
+            TraceBuffer* buffer = g_free;
+            if (buffer)
+            {
+                g_free = buffer->next_free;
+                buffer->next_free = 0;
+                buffer->free = false;
+                buffer->Reset();
+                return buffer;
+            }
+        }
+
+        TraceBuffer* buffer = new TraceBuffer;
+        TraceBuffer* head = g_buffers.load(std::memory_order_relaxed);
+        do
+        {
+            buffer->next = head;
+        } while (!g_buffers.compare_exchange_weak(head, buffer, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+        return buffer;
+    }
+
+    static TraceBuffer* CurrentBuffer()
+    {
+        if (!g_current_buffer)
+        {
+            g_current_buffer = AdoptBuffer();
+            RegisterThreadExit(OnThreadExit, g_current_buffer);
+        }
+
+        return g_current_buffer;
+    }
+
+    void TraceLog::Enable()
+    {
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    void TraceLog::Disable()
+    {
+        enabled_.store(false, std::memory_order_relaxed);
+    }
+
+    void TraceLog::SetThreadName(const char* name)
+    {
+        TraceBuffer* buffer = CurrentBuffer();
+        strncpy(buffer->thread_name, name, sizeof(buffer->thread_name) - 1);
+        buffer->thread_name[sizeof(buffer->thread_name) - 1] = 0;
+    }
+
+    void TraceLog::Begin(const char* category, const char* name, const Location& from_here)
+    {
+        CurrentBuffer()->Add('B', category, name, 0, from_here);
+    }
+
+    void TraceLog::End(const char* category, const char* name)
+    {
+        CurrentBuffer()->Add('E', category, name, 0, Location());
+    }
+
+    void TraceLog::Instant(const char* category, const char* name)
+    {
+        CurrentBuffer()->Add('i', category, name, 0, Location());
+    }
+
+    unsigned long long TraceLog::FlowBegin(const char* category, const char* name)
+    {
+        unsigned long long id = g_next_flow_id.fetch_add(1, std::memory_order_relaxed);
+        CurrentBuffer()->Add('s', category, name, id, Location());
+        return id;
+    }
+
+    void TraceLog::FlowEnd(const char* category, const char* name, unsigned long long id)
+    {
+        CurrentBuffer()->Add('f', category, name, id, Location());
+    }
+
+    static void WriteJsonString(FILE* file, const char* value)
+    {
+        fputc('"', file);
+        for (const char* p = value ? value : ""; *p; ++p)
+        {
+            unsigned char c = (unsigned char)*p;
+            if (c == '"' || c == '\\')
+                fprintf(file, "\\%c", c);
+            else if (c < 0x20)
+                fprintf(file, "\\u%04x", c);
+            else
+                fputc(c, file);
+        }
+        fputc('"', file);
+    }
+
+    bool TraceLog::WriteJson(FILE* file)
+    {
+        if (!file)
+        {
+            return false;
+        }
+
+#if defined(_WIN32)
+        unsigned long pid = ::GetCurrentProcessId();
+#else
+        unsigned long pid = (unsigned long)::getpid();
+#endif
+
+        // buffers of threads that exit from here on wait for the next dump
+        TraceBuffer* dumped = 0;
+        {
+            AutoLocker<CSLocker> guard(&g_free_locker);
+            dumped = g_exited;
+            g_exited = 0;
+        }
+
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        bool first = true;
+        std::vector<TraceEvent> events;
+        for (TraceBuffer* buffer = g_buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+        {
+            // a free buffer was written by the dump that freed it, and a
+            // new thread may be taking it over
+            unsigned long long thread_id;
+            char               thread_name[sizeof(buffer->thread_name)];
+            {
+                AutoLocker<CSLocker> guard(&g_free_locker);
+                if (buffer->free)
+                    continue;
+
+                thread_id = buffer->thread_id;
+                memcpy(thread_name, buffer->thread_name, sizeof(thread_name));
+            }
+
+            if (thread_name[0])
+            {
+                fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%lu,\"tid\":%llu,\"args\":{\"name\":",
+                        first ? "" : ",", pid, thread_id);
+                WriteJsonString(file, thread_name);
+                fprintf(file, "}}");
+                first = false;
+            }
+
+            buffer->Copy(&events);
+            for (size_t i = 0; i < events.size(); ++i)
+            {
+                const TraceEvent& event = events[i];
+                fprintf(file, "%s\n{\"ph\":\"%c\",\"cat\":", first ? "" : ",", event.phase);
+                WriteJsonString(file, event.category);
+                fprintf(file, ",\"name\":");
+                WriteJsonString(file, event.name);
+                fprintf(file, ",\"ts\":%lld.%03lld,\"pid\":%lu,\"tid\":%llu",
+                        event.ts / 1000, event.ts % 1000, pid, thread_id);
+
+                if (event.phase == 's' || event.phase == 'f')
+                    fprintf(file, ",\"id\":%llu", event.id);
+                if (event.phase == 'f')
+                    fprintf(file, ",\"bp\":\"e\"");
+                if (event.phase == 'i')
+                    fprintf(file, ",\"s\":\"t\"");
+                if (event.file)
+                {
+                    fprintf(file, ",\"args\":{\"file\":");
+                    WriteJsonString(file, event.file);
+                    fprintf(file, ",\"line\":%d}", event.line);
+                }
+
+                fprintf(file, "}");
+                first = false;
+            }
+        }
+        fprintf(file, "\n]}\n");
+
+        if (dumped)
+        {
+            AutoLocker<CSLocker> guard(&g_free_locker);
+            TraceBuffer* last = dumped;
+            for (;;)
+            {
+                last->free = true;
+                if (!last->next_free)
+                    break;
+                last = last->next_free;
+            }
+
+            last->next_free = g_free;
+            g_free = dumped;
+        }
+
+        return ferror(file) == 0;
+    }
+
+    bool TraceLog::WriteJson(const char* path)
+    {
+        FILE* file = fopen(path, "w");
+        if (!file)
+        {
+            return false;
+        }
+
+        bool written = WriteJson(file);
+        return fclose(file) == 0 && written;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef __base_trace_event_h__
+#define __base_trace_event_h__
+
+#include "base/def.h"
+#include "base/location.h"
+
+#include <atomic>
+#include <stdio.h>
+
+namespace base
+{
+    /*
+     * Process-wide recorder of trace events in the Chrome trace format,
+     * for chrome://tracing or ui.perfetto.dev. Every thread appends to a
+     * ring of its last kEventsPerThread events without taking a lock, and
+     * WriteJson() collects the rings. The ring of a thread that exited is
+     * kept until a dump has written it, then goes to a new thread.
+     * Categories and names are kept by pointer, so they must be string
+     * literals or live as long.
+     */
+    class TraceLog
+    {
+    public:
+        static const unsigned int kEventsPerThread = 1u << 14;
+
+        static void Enable();
+        static void Disable();
+
+        // the one branch a disabled trace point costs
+        static bool IsEnabled()
+        {
+            return enabled_.load(std::memory_order_relaxed);
+        }
+
+        // Names the calling thread in the dump. The name is copied.
+        static void SetThreadName(const char* name);
+
+        static void Begin(const char* category, const char* name, const Location& from_here = Location());
+        static void End(const char* category, const char* name);
+        static void Instant(const char* category, const char* name);
+
+        // A flow arrow from the slice open on this thread, see
+        // FlowBegin, to the slice open where FlowEnd is called with the
+        // same id. FlowBegin returns a fresh id.
+        static unsigned long long FlowBegin(const char* category, const char* name);
+        static void               FlowEnd(const char* category, const char* name, unsigned long long id);
+
+        // Writes the recorded events as JSON. Events recorded while it
+        // runs may be left out.
+        static bool WriteJson(FILE* file);
+        static bool WriteJson(const char* path);
+
+    private:
+        static std::atomic<bool> enabled_;
+    };
+
+    class ScopedTraceEvent
+    {
+    public:
+        ScopedTraceEvent(const char* category, const char* name, const Location& from_here)
+            : category_(0), name_(name)
+        {
+            if (TraceLog::IsEnabled())
+            {
+                category_ = category;
+                TraceLog::Begin(category, name, from_here);
+            }
+        }
+
+        // a slice begun while enabled is always closed
+        ~ScopedTraceEvent()
+        {
+            if (category_)
+                TraceLog::End(category_, name_);
+        }
+
+    private:
+        const char* category_;
+        const char* name_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(ScopedTraceEvent)
+    };
+}
+
+#define BASE_TRACE_CONCAT_(a, b) a##b
+#define BASE_TRACE_CONCAT(a, b) BASE_TRACE_CONCAT_(a, b)
+
+// Traces the rest of the enclosing scope as one slice.
+#define TRACE_EVENT(category, name) \
+    base::ScopedTraceEvent BASE_TRACE_CONCAT(trace_event_, __LINE__)(category, name, FROM_HERE)
+
+#define TRACE_EVENT_BEGIN(category, name) \
+    do { if (base::TraceLog::IsEnabled()) base::TraceLog::Begin(category, name, FROM_HERE); } while (0)
+
+#define TRACE_EVENT_END(category, name) \
+    do { if (base::TraceLog::IsEnabled()) base::TraceLog::End(category, name); } while (0)
+
+#define TRACE_EVENT_INSTANT(category, name) \
+    do { if (base::TraceLog::IsEnabled()) base::TraceLog::Instant(category, name); } while (0)
+
+#endif
@@ -1,6 +1,14 @@
 #ifndef __base_tuple_h__
 #define __base_tuple_h__
 
+#include "def.h"
+
+#if defined(BASE_HAS_VARIADIC_TEMPLATES)
+#include <stddef.h>
+#include <tuple>
+#include <utility>
+#endif
+
 /*
  * TupleTraits
  */
@@ -364,4 +372,37 @@ inline void DispatchToMethod(Object* obj, Method method, const Tuple8<A, B, C, D
     (obj->*method)(arg.a, arg.b, arg.c, arg.d, arg.e, arg.f, arg.g, arg.h);
 }
 
+#if defined(BASE_HAS_VARIADIC_TEMPLATES)
+/*
+ * std::tuple parameters, moved into the method since a task runs once
+ */
+template<size_t... Indexes>
+struct IndexSequence {};
+
+template<size_t N, size_t... Indexes>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Indexes...> {};
+
+template<size_t... Indexes>
+struct MakeIndexSequence<0, Indexes...>
+{
+    typedef IndexSequence<Indexes...> Type;
+};
+
+template<typename Object, typename Method,
+         typename... Args, size_t... Indexes>
+inline void DispatchToMethodImpl(Object* obj, Method method, std::tuple<Args...>& arg,
+                                 IndexSequence<Indexes...>)
+{
+    (obj->*method)(std::move(std::get<Indexes>(arg))...);
+}
+
+template<typename Object, typename Method,
+         typename... Args>
+inline void DispatchToMethod(Object* obj, Method method, std::tuple<Args...>& arg)
+{
+    DispatchToMethodImpl(obj, method, arg,
+                         typename MakeIndexSequence<sizeof...(Args)>::Type());
+}
+#endif
+
 #endif
\ No newline at end of file
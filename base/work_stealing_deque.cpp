@@ -0,0 +1,118 @@
+#include "work_stealing_deque.h"
+
+#include <stddef.h>
+
+namespace base
+{
+    WorkStealingDeque::Ring::Ring(long long capacity)
+        : capacity(capacity)
+        , items(new std::atomic<Task*>[(size_t)capacity]) {}
+
+    WorkStealingDeque::Ring::~Ring()
+    {
+        delete [] items;
+    }
+
+    Task* WorkStealingDeque::Ring::Get(long long index) const
+    {
+        return items[index & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void WorkStealingDeque::Ring::Put(long long index, Task* task)
+    {
+        items[index & (capacity - 1)].store(task, std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque::WorkStealingDeque()
+        : top_(0)
+        , bottom_(0)
+        , ring_(new Ring(kInitialCapacity)) {}
+
+    WorkStealingDeque::~WorkStealingDeque()
+    {
+        delete ring_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < retired_.size(); ++i)
+            delete retired_[i];
+    }
+
+    void WorkStealingDeque::Push(Task* task)
+    {
+        long long bottom = bottom_.load(std::memory_order_relaxed);
+        long long top = top_.load(std::memory_order_acquire);
+        Ring* ring = ring_.load(std::memory_order_relaxed);
+
+        if (bottom - top > ring->capacity - 1)
+            ring = Grow(ring, bottom, top);
+
+        ring->Put(bottom, task);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    Task* WorkStealingDeque::Take()
+    {
+        long long bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Ring* ring = ring_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return 0;
+        }
+
+        Task* task = ring->Get(bottom);
+        if (top == bottom)
+        {
+            // last item, race the thieves for it
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed))
+            {
+                task = 0;
+            }
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return task;
+    }
+
+    Task* WorkStealingDeque::Steal()
+    {
+        long long top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long bottom = bottom_.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return 0;
+
+        Ring* ring = ring_.load(std::memory_order_acquire);
+        Task* task = ring->Get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+        {
+            return 0;
+        }
+
+        return task;
+    }
+
+    bool WorkStealingDeque::Empty() const
+    {
+        long long bottom = bottom_.load(std::memory_order_relaxed);
+        long long top = top_.load(std::memory_order_relaxed);
+        return bottom <= top;
+    }
+
+    WorkStealingDeque::Ring* WorkStealingDeque::Grow(Ring* ring, long long bottom, long long top)
+    {
+        Ring* bigger = new Ring(ring->capacity * 2);
+        for (long long i = top; i < bottom; ++i)
+            bigger->Put(i, ring->Get(i));
+
+        retired_.push_back(ring);
+        ring_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef __base_work_stealing_deque_h__
+#define __base_work_stealing_deque_h__
+
+#include "base/def.h"
+#include "base/task.h"
+
+#include <atomic>
+#include <vector>
+
+namespace base
+{
+    /*
+     * Chase-Lev work-stealing deque of Task (Le et al., "Correct and
+     * Efficient Work-Stealing for Weak Memory Models"). The owning worker
+     * pushes and takes at the bottom, LIFO; any other thread steals from
+     * the top, FIFO. The ring doubles when full, and retired rings are
+     * kept until the deque dies since a thief may still be reading one.
+     */
+    class WorkStealingDeque
+    {
+    public:
+        WorkStealingDeque();
+        ~WorkStealingDeque();
+
+        void  Push(Task* task);
+        Task* Take();
+        Task* Steal();
+        bool  Empty() const;
+
+    private:
+        struct Ring
+        {
+            explicit Ring(long long capacity);
+            ~Ring();
+
+            Task* Get(long long index) const;
+            void  Put(long long index, Task* task);
+
+            long long           capacity;
+            std::atomic<Task*>* items;
+        };
+
+        Ring* Grow(Ring* ring, long long bottom, long long top);
+
+        static const int kInitialCapacity = 256;
+        static const int kCacheLineSize = 64;
+
+        std::atomic<long long> top_;
+        char                   pad_[kCacheLineSize - sizeof(std::atomic<long long>)];
+        std::atomic<long long> bottom_;
+        std::atomic<Ring*>     ring_;
+        std::vector<Ring*>     retired_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(WorkStealingDeque)
+    };
+}
+
+#endif
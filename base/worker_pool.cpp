@@ -0,0 +1,341 @@
+#include "worker_pool.h"
+#include "task_allocator.h"
+
+#include <chrono>
+#include <limits.h>
+
+namespace base
+{
+    THREAD_LOCAL WorkerPool::Worker* WorkerPool::current_worker_ = 0;
+
+    WorkerPool::WorkerPool(int num_workers)
+        : injected_count_(0)
+        , next_delayed_run_time_(0)
+        , num_sleeping_(0)
+        , quit_(false)
+        , code_(0)
+    {
+        if (num_workers <= 0)
+            num_workers = (int)std::thread::hardware_concurrency();
+        if (num_workers <= 0)
+            num_workers = 1;
+
+        for (int i = 0; i < num_workers; ++i)
+        {
+            Worker* worker = new Worker;
+            worker->pool = this;
+            worker->index = i;
+            worker->seed = 2654435761u * (i + 1);
+            workers_.push_back(worker);
+        }
+
+        for (int i = 0; i < num_workers; ++i)
+            workers_[i]->thread = std::thread(&WorkerPool::WorkerMain, this, workers_[i]);
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        Quit(0);
+        JoinWorkers();
+        DiscardTasks();
+
+        for (size_t i = 0; i < workers_.size(); ++i)
+            delete workers_[i];
+    }
+
+    int WorkerPool::Run()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!quit_)
+                quit_event_.wait(lock);
+        }
+
+        JoinWorkers();
+        return code_;
+    }
+
+    bool WorkerPool::Quit(int code)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (quit_)
+                return true;
+
+            code_ = code;
+            quit_ = true;
+        }
+
+        wakeup_.notify_all();
+        quit_event_.notify_all();
+        return true;
+    }
+
+    TaskHandle WorkerPool::PostTask(Task* task)
+    {
+        TaskHandle handle;
+        if (!task || quit_)
+            return handle;
+
+        Task* slot_task = task_slots_.Wrap(task, &handle);
+        if (!slot_task)
+            return handle;
+
+        Worker* worker = current_worker_;
+        if (worker && worker->pool == this)
+        {
+            worker->deque.Push(slot_task);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            injected_.push_back(slot_task);
+            injected_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        WakeWorker();
+        return handle;
+    }
+
+    TaskHandle WorkerPool::PostDelayTask(Task* task, int delay_time)
+    {
+        return PostDelayTask(task, TimeDelta::FromMilliseconds(delay_time));
+    }
+
+    TaskHandle WorkerPool::PostDelayTask(Task* task, const TimeDelta& delay)
+    {
+        TaskHandle handle;
+        if (!task || quit_)
+            return handle;
+
+        Task* slot_task = task_slots_.Wrap(task, &handle);
+        if (!slot_task)
+            return handle;
+
+        TimeTicks delayed_run_time = TimeTicks::Now() + delay;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            delay_task_queue_.Push(slot_task, delayed_run_time);
+            next_delayed_run_time_.store(delay_task_queue_.NextExpireTime().ToInternalValue());
+
+            // a parked worker may be sleeping towards a later deadline
+            if (num_sleeping_.load() > 0)
+                wakeup_.notify_one();
+        }
+
+        return handle;
+    }
+
+    int WorkerPool::WorkerCount() const
+    {
+        return (int)workers_.size();
+    }
+
+    void WorkerPool::WorkerMain(Worker* worker)
+    {
+        current_worker_ = worker;
+
+        while (!quit_.load(std::memory_order_acquire))
+        {
+            Task* task = FindTask(worker);
+            if (task)
+            {
+                // slots delete the task they ran and recycle themselves
+                task->Run();
+                continue;
+            }
+
+            TaskAllocator::FlushRemoteFrees();
+            Park();
+        }
+
+        current_worker_ = 0;
+    }
+
+    Task* WorkerPool::FindTask(Worker* worker)
+    {
+        // due delayed tasks jump ahead of the local deque, a busy pool would
+        // otherwise only look at them once it ran dry
+        Task* task = 0;
+        long long next_delayed_run_time = next_delayed_run_time_.load(std::memory_order_relaxed);
+        if (next_delayed_run_time &&
+            TimeTicks::Now().ToInternalValue() >= next_delayed_run_time)
+        {
+            task = TakeInjectedTask(worker);
+            if (task)
+                return task;
+        }
+
+        task = worker->deque.Take();
+        if (task)
+            return task;
+
+        task = TakeInjectedTask(worker);
+        if (task)
+            return task;
+
+        return StealTask(worker);
+    }
+
+    Task* WorkerPool::TakeInjectedTask(Worker* worker)
+    {
+        long long next_delayed_run_time = next_delayed_run_time_.load(std::memory_order_relaxed);
+        TimeTicks now;
+        bool delay_due = false;
+        if (next_delayed_run_time)
+        {
+            now = TimeTicks::Now();
+            delay_due = now.ToInternalValue() >= next_delayed_run_time;
+        }
+
+        if (!delay_due && injected_count_.load(std::memory_order_relaxed) == 0)
+            return 0;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (delay_due)
+            MoveDueDelayTasks(now);
+
+        if (injected_.empty())
+            return 0;
+
+        // take a batch so the next few tasks cost no lock, the rest of the
+        // batch stays stealable in this worker's deque
+        Task* task = injected_.front();
+        injected_.pop_front();
+
+        int moved = 1;
+        while (moved < kInjectBatch && !injected_.empty() && !delay_due)
+        {
+            worker->deque.Push(injected_.front());
+            injected_.pop_front();
+            ++moved;
+        }
+
+        injected_count_.fetch_sub(moved, std::memory_order_relaxed);
+        return task;
+    }
+
+    Task* WorkerPool::StealTask(Worker* worker)
+    {
+        int count = (int)workers_.size();
+        if (count < 2)
+            return 0;
+
+        worker->seed = worker->seed * 1103515245u + 12345u;
+        int start = (int)((worker->seed >> 16) % (unsigned int)count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            Worker* victim = workers_[(start + i) % count];
+            if (victim == worker)
+                continue;
+
+            Task* task = victim->deque.Steal();
+            if (task)
+                return task;
+        }
+
+        return 0;
+    }
+
+    void WorkerPool::Park()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        // announce the sleep before the last look for work, a producer
+        // either sees the sleeper or the sleeper sees its task
+        num_sleeping_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (quit_ || HasWork())
+        {
+            num_sleeping_.fetch_sub(1);
+            return;
+        }
+
+        TimeTicks delayed_run_time = delay_task_queue_.NextExpireTime();
+        if (delayed_run_time.is_null())
+        {
+            wakeup_.wait(lock);
+        }
+        else
+        {
+            TimeDelta timeout = delayed_run_time - TimeTicks::Now();
+            wakeup_.wait_for(lock, std::chrono::nanoseconds(timeout.InNanoseconds()));
+        }
+
+        num_sleeping_.fetch_sub(1);
+    }
+
+    void WorkerPool::WakeWorker()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (num_sleeping_.load(std::memory_order_relaxed) == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        wakeup_.notify_one();
+    }
+
+    bool WorkerPool::HasWork()
+    {
+        if (!injected_.empty())
+            return true;
+
+        TimeTicks delayed_run_time = delay_task_queue_.NextExpireTime();
+        if (!delayed_run_time.is_null() && delayed_run_time <= TimeTicks::Now())
+            return true;
+
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            if (!workers_[i]->deque.Empty())
+                return true;
+        }
+
+        return false;
+    }
+
+    void WorkerPool::MoveDueDelayTasks(const TimeTicks& now)
+    {
+        // due tasks go to the front, in expire order, ahead of the backlog
+        std::deque<Task*>::iterator position = injected_.begin();
+        while (Task* task = delay_task_queue_.PopExpired(now))
+        {
+            position = injected_.insert(position, task) + 1;
+            injected_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        next_delayed_run_time_.store(delay_task_queue_.NextExpireTime().ToInternalValue());
+    }
+
+    void WorkerPool::JoinWorkers()
+    {
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            if (workers_[i]->thread.joinable() &&
+                workers_[i]->thread.get_id() != std::this_thread::get_id())
+            {
+                workers_[i]->thread.join();
+            }
+        }
+    }
+
+    void WorkerPool::DiscardTasks()
+    {
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            while (Task* task = workers_[i]->deque.Take())
+                TaskSlotTable::Discard(task);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!injected_.empty())
+        {
+            TaskSlotTable::Discard(injected_.front());
+            injected_.pop_front();
+        }
+
+        TimeTicks end_of_time = TimeTicks::FromInternalValue(LLONG_MAX);
+        while (Task* task = delay_task_queue_.PopExpired(end_of_time))
+            TaskSlotTable::Discard(task);
+    }
+}
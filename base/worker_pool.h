@@ -0,0 +1,92 @@
+#ifndef __base_worker_pool_h__
+#define __base_worker_pool_h__
+
+#include "base/def.h"
+#include "base/delay_task_queue.h"
+#include "base/task.h"
+#include "base/task_handle.h"
+#include "base/time_ticks.h"
+#include "base/work_stealing_deque.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace base
+{
+    /*
+     * Runs tasks on N worker threads with the posting interface of
+     * TaskCenter, so a call site can switch from a TaskCenter to a pool by
+     * changing the type. Tasks posted from a worker go to its own
+     * work-stealing deque, and those posted from other threads go to a
+     * shared injection queue. Idle workers steal from each other before
+     * they park on a condition variable. Workers start with the pool, and
+     * Run() only blocks the caller until Quit().
+     */
+    class WorkerPool
+    {
+    public:
+        // 0 workers means one per hardware thread
+        explicit WorkerPool(int num_workers = 0);
+        ~WorkerPool();
+
+        int  Run();
+        bool Quit(int code);
+
+        TaskHandle PostTask(Task* task);
+        TaskHandle PostDelayTask(Task* task, int delay_time);
+        TaskHandle PostDelayTask(Task* task, const TimeDelta& delay);
+
+        int WorkerCount() const;
+
+    private:
+        struct Worker
+        {
+            WorkerPool*       pool;
+            int               index;
+            unsigned int      seed;
+            WorkStealingDeque deque;
+            std::thread       thread;
+        };
+
+        void  WorkerMain(Worker* worker);
+        Task* FindTask(Worker* worker);
+        Task* TakeInjectedTask(Worker* worker);
+        Task* StealTask(Worker* worker);
+        void  Park();
+        void  WakeWorker();
+
+        bool  HasWork();
+        void  MoveDueDelayTasks(const TimeTicks& now);
+        void  JoinWorkers();
+        void  DiscardTasks();
+
+        static const int kInjectBatch = 32;
+
+    private:
+        TaskSlotTable             task_slots_;
+        std::vector<Worker*>      workers_;
+
+        std::mutex                mutex_;
+        std::condition_variable   wakeup_;
+        std::condition_variable   quit_event_;
+        std::deque<Task*>         injected_;
+        std::atomic<long>         injected_count_;
+        DelayTaskQueue            delay_task_queue_;
+        std::atomic<long long>    next_delayed_run_time_;
+        std::atomic<long>         num_sleeping_;
+
+        std::atomic<bool>         quit_;
+        int                       code_;
+
+        static THREAD_LOCAL Worker* current_worker_;
+
+    private:
+        DISABLE_COPY_AND_ASSIGN(WorkerPool)
+    };
+}
+
+#endif
@@ -0,0 +1,799 @@
+/*
+ * Benchmarks for the hot paths of base, written as JSON so runs can be
+ * compared against a saved baseline.
+ *
+ *   g++ -std=c++11 -O2 -I. bench/base_bench.cpp $(find base -name '*.cpp') \
+ *       -lpthread -o base_bench
+ *   ./base_bench [-o result.json] [name-filter]
+ *
+ * Every result is an object with a name and flat numeric fields; times
+ * are in nanoseconds and rates per second.
+ */
+#include "base/delay_task_queue.h"
+#include "base/histogram.h"
+#include "base/keyed_worker_pool.h"
+#include "base/locker.h"
+#include "base/singleton.h"
+#include "base/task.h"
+#include "base/task_center.hpp"
+#include "base/time_ticks.h"
+#include "base/timing_wheel.h"
+#include "base/trace_event.h"
+#include "base/worker_pool.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using base::Task;
+    using base::TimeDelta;
+    using base::TimeTicks;
+
+    struct Result
+    {
+        std::string                                name;
+        std::vector<std::pair<std::string, double> > fields;
+
+        Result& Add(const char* field, double value)
+        {
+            fields.push_back(std::make_pair(std::string(field), value));
+            return *this;
+        }
+    };
+
+    std::vector<Result> g_results;
+    const char*         g_filter = 0;
+
+    bool Enabled(const std::string& name)
+    {
+        return !g_filter || name.find(g_filter) != std::string::npos;
+    }
+
+    Result& AddResult(const std::string& name)
+    {
+        g_results.push_back(Result());
+        g_results.back().name = name;
+        fprintf(stderr, "%s\n", name.c_str());
+        return g_results.back();
+    }
+
+    double NanosecondsSince(const TimeTicks& start)
+    {
+        return (double)(TimeTicks::Now() - start).InNanoseconds();
+    }
+
+    void WriteJson(FILE* out)
+    {
+        fprintf(out, "{\n  \"benchmarks\": [\n");
+        for (size_t i = 0; i < g_results.size(); ++i)
+        {
+            const Result& result = g_results[i];
+            fprintf(out, "    {\"name\": \"%s\"", result.name.c_str());
+            for (size_t j = 0; j < result.fields.size(); ++j)
+                fprintf(out, ", \"%s\": %.3f", result.fields[j].first.c_str(), result.fields[j].second);
+            fprintf(out, "}%s\n", i + 1 < g_results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+
+    class NopTask : public Task
+    {
+    public:
+        virtual void Run() {}
+    };
+
+    /*
+     * single-thread PostTask/DoTask throughput
+     */
+    class QuitTask : public Task
+    {
+    public:
+        explicit QuitTask(TaskCenterIO* center) : center_(center) {}
+        virtual void Run() { center_->Quit(0); }
+
+    private:
+        TaskCenterIO* center_;
+    };
+
+    void BenchPostTaskThroughput()
+    {
+        const int kTasks = 1000000;
+        const int budgets[] = { 1, 64, 0 };
+
+        for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); ++i)
+        {
+            char name[64];
+            sprintf(name, "post_task/single_thread/budget_%d", budgets[i]);
+            if (!Enabled(name))
+                continue;
+
+            TaskCenterIO center;
+            center.SetTaskBudget(budgets[i], 0);
+
+            TimeTicks start = TimeTicks::Now();
+            for (int j = 0; j < kTasks; ++j)
+                center.PostTask(new NopTask());
+            center.PostTask(new QuitTask(&center));
+            double post_ns = NanosecondsSince(start);
+
+            start = TimeTicks::Now();
+            center.Run();
+            double run_ns = NanosecondsSince(start);
+
+            AddResult(name)
+                .Add("tasks", kTasks)
+                .Add("post_ns_per_task", post_ns / kTasks)
+                .Add("run_ns_per_task", run_ns / kTasks)
+                .Add("tasks_per_second", kTasks / ((post_ns + run_ns) / 1e9));
+        }
+    }
+
+    /*
+     * cross-thread post-to-run latency
+     */
+    class StampTask : public Task
+    {
+    public:
+        StampTask(base::Histogram* histogram, std::atomic<int>* done)
+            : histogram_(histogram), done_(done), posted_(TimeTicks::Now()) {}
+
+        virtual void Run()
+        {
+            histogram_->Add((TimeTicks::Now() - posted_).InNanoseconds());
+            done_->fetch_add(1, std::memory_order_release);
+        }
+
+    private:
+        base::Histogram*  histogram_;
+        std::atomic<int>* done_;
+        TimeTicks         posted_;
+    };
+
+    template<typename Center>
+    void BenchCrossThreadLatency(const char* pump_name)
+    {
+        const int kSamples = 20000;
+
+        char name[96];
+        sprintf(name, "post_task/cross_thread_latency/%s", pump_name);
+        if (!Enabled(name))
+            return;
+
+        Center center;
+        std::thread consumer([&center]() { center.Run(); });
+
+        // one task in flight at a time, so every sample includes a wakeup
+        base::Histogram histogram;
+        std::atomic<int> done(0);
+        for (int i = 0; i < kSamples; ++i)
+        {
+            center.PostTask(new StampTask(&histogram, &done));
+            while (done.load(std::memory_order_acquire) <= i)
+                std::this_thread::yield();
+        }
+
+        center.Quit(0);
+        consumer.join();
+
+        base::HistogramSnapshot snapshot;
+        histogram.Snapshot(&snapshot);
+        AddResult(name)
+            .Add("samples", (double)snapshot.count)
+            .Add("mean_ns", snapshot.Mean())
+            .Add("p50_ns", (double)snapshot.Percentile(50))
+            .Add("p90_ns", (double)snapshot.Percentile(90))
+            .Add("p99_ns", (double)snapshot.Percentile(99))
+            .Add("p999_ns", (double)snapshot.Percentile(99.9))
+            .Add("max_ns", (double)snapshot.max);
+    }
+
+    /*
+     * what a producer pays per post to a pump that is kept busy
+     */
+    template<typename Center>
+    void BenchCrossThreadPost(const char* pump_name)
+    {
+        const int kTasks = 1000000;
+
+        char name[96];
+        sprintf(name, "post_task/cross_thread_post/%s", pump_name);
+        if (!Enabled(name))
+            return;
+
+        Center center;
+        center.SetTaskBudget(0, 0);
+        std::thread consumer([&center]() { center.Run(); });
+
+        TimeTicks start = TimeTicks::Now();
+        for (int i = 0; i < kTasks; ++i)
+            center.PostTask(new NopTask());
+        double post_ns = NanosecondsSince(start);
+
+        center.Quit(0);
+        consumer.join();
+
+        AddResult(name)
+            .Add("tasks", kTasks)
+            .Add("post_ns_per_task", post_ns / kTasks);
+    }
+
+    void BenchCrossThread()
+    {
+        BenchCrossThreadLatency<TaskCenterIO>("epoll_pump");
+        BenchCrossThreadLatency<base::TaskCenter<base::FutexPump> >("futex_pump");
+        BenchCrossThreadPost<TaskCenterIO>("epoll_pump");
+        BenchCrossThreadPost<base::TaskCenter<base::FutexPump> >("futex_pump");
+    }
+
+    /*
+     * tasks posted from a running task to its own center, with the
+     * center's locks and queues real or compiled away
+     */
+    template<typename Center>
+    class SelfPostTask : public Task
+    {
+    public:
+        SelfPostTask(Center* center, int tasks, int delay_tasks, double* post_ns)
+            : center_(center), tasks_(tasks), delay_tasks_(delay_tasks), post_ns_(post_ns) {}
+
+        virtual void Run()
+        {
+            TimeTicks start = TimeTicks::Now();
+            for (int i = 0; i < tasks_; ++i)
+                center_->PostTask(new NopTask());
+            for (int i = 0; i < delay_tasks_; ++i)
+                center_->PostDelayTask(new NopTask(), TimeDelta());
+            *post_ns_ = NanosecondsSince(start);
+
+            Center* center = center_;
+            center_->PostDelayTask(base::NewCallableTask([center]() { center->Quit(0); }),
+                                   TimeDelta::FromMilliseconds(1));
+        }
+
+    private:
+        Center* center_;
+        int     tasks_;
+        int     delay_tasks_;
+        double* post_ns_;
+    };
+
+    template<template<typename Locker> class Guard>
+    void BenchSameThreadPost(const char* guard_name, bool delayed)
+    {
+        typedef base::TaskCenter<base::EpollPump, base::DelayTaskQueue, Guard> Center;
+        const int kTasks = 1000000;
+
+        char name[96];
+        sprintf(name, "%s/same_thread/%s", delayed ? "post_delay_task" : "post_task", guard_name);
+        if (!Enabled(name))
+            return;
+
+        Center center;
+        center.SetTaskBudget(0, 0);
+
+        double post_ns = 0;
+        center.PostTask(new SelfPostTask<Center>(&center, delayed ? 0 : kTasks, delayed ? kTasks : 0, &post_ns));
+
+        TimeTicks start = TimeTicks::Now();
+        center.Run();
+        double total_ns = NanosecondsSince(start);
+
+        AddResult(name)
+            .Add("tasks", kTasks)
+            .Add("post_ns_per_task", post_ns / kTasks)
+            .Add("run_ns_per_task", (total_ns - post_ns) / kTasks);
+    }
+
+    void BenchSameThread()
+    {
+        BenchSameThreadPost<base::MultiThreadGuard>("multi_thread_guard", false);
+        BenchSameThreadPost<base::SingleThreadGuard>("single_thread_guard", false);
+        BenchSameThreadPost<base::MultiThreadGuard>("multi_thread_guard", true);
+        BenchSameThreadPost<base::SingleThreadGuard>("single_thread_guard", true);
+    }
+
+    /*
+     * delayed-task insert/expire
+     */
+    template<typename DelayQueue>
+    void BenchDelayQueue(const char* queue_name, int timers)
+    {
+        char name[96];
+        sprintf(name, "delay_queue/%s/%d", queue_name, timers);
+        if (!Enabled(name))
+            return;
+
+        std::vector<NopTask> tasks(timers);
+        DelayQueue* queue = new DelayQueue();
+
+        // deadlines spread over ten seconds in a scrambled order
+        TimeTicks base_time = TimeTicks::Now();
+        unsigned int seed = 12345;
+        TimeTicks start = TimeTicks::Now();
+        for (int i = 0; i < timers; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            long long delay_us = (seed >> 8) % 10000000;
+            queue->Push(&tasks[i], base_time + TimeDelta::FromMicroseconds(delay_us));
+        }
+        double insert_ns = NanosecondsSince(start);
+
+        TimeTicks end_time = base_time + TimeDelta::FromSeconds(11);
+        int expired = 0;
+        start = TimeTicks::Now();
+        while (queue->PopExpired(end_time))
+            ++expired;
+        double expire_ns = NanosecondsSince(start);
+
+        delete queue;
+
+        AddResult(name)
+            .Add("timers", timers)
+            .Add("insert_ns_per_timer", insert_ns / timers)
+            .Add("expire_ns_per_timer", expire_ns / (expired ? expired : 1));
+    }
+
+    void BenchDelayQueues()
+    {
+        const int counts[] = { 1000, 100000, 1000000 };
+        for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+        {
+            BenchDelayQueue<base::DelayTaskQueue>("heap", counts[i]);
+            BenchDelayQueue<base::TimingWheel>("timing_wheel", counts[i]);
+        }
+    }
+
+    /*
+     * NewMethodTask by arity
+     */
+    class Target
+    {
+    public:
+        Target() : sum_(0) {}
+
+        void Method0() { Add(1); }
+        void Method1(int a) { Add(a); }
+        void Method2(int a, int b) { Add(a + b); }
+        void Method3(int a, int b, int c) { Add(a + b + c); }
+        void Method4(int a, int b, int c, int d) { Add(a + b + c + d); }
+        void Method6(int a, int b, int c, int d, int e, int f) { Add(a + b + c + d + e + f); }
+        void MethodString(const std::string& s) { Add((long long)s.size()); }
+
+        // a plain read and write, ++ and += on a volatile are deprecated in C++20
+        void Add(long long value) { sum_ = sum_ + value; }
+
+        volatile long long sum_;
+    };
+
+    template<typename MakeTask>
+    void BenchMethodTask(const char* arity, MakeTask make_task)
+    {
+        const int kIterations = 2000000;
+
+        std::string base_name = std::string("new_method_task/") + arity;
+        if (!Enabled(base_name))
+            return;
+
+        TimeTicks start = TimeTicks::Now();
+        for (int i = 0; i < kIterations; ++i)
+        {
+            Task* task = make_task(i);
+            delete task;
+        }
+        double alloc_ns = NanosecondsSince(start);
+
+        start = TimeTicks::Now();
+        for (int i = 0; i < kIterations; ++i)
+        {
+            Task* task = make_task(i);
+            task->Run();
+            delete task;
+        }
+        double total_ns = NanosecondsSince(start);
+
+        AddResult(base_name)
+            .Add("new_delete_ns", alloc_ns / kIterations)
+            .Add("new_run_delete_ns", total_ns / kIterations)
+            .Add("dispatch_ns", (total_ns - alloc_ns) / kIterations);
+    }
+
+    Target g_target;
+
+    Task* MakeTask0(int) { return base::NewMethodTask(&g_target, &Target::Method0); }
+    Task* MakeTask1(int i) { return base::NewMethodTask(&g_target, &Target::Method1, i); }
+    Task* MakeTask2(int i) { return base::NewMethodTask(&g_target, &Target::Method2, i, i); }
+    Task* MakeTask3(int i) { return base::NewMethodTask(&g_target, &Target::Method3, i, i, i); }
+    Task* MakeTask4(int i) { return base::NewMethodTask(&g_target, &Target::Method4, i, i, i, i); }
+    Task* MakeTask6(int i) { return base::NewMethodTask(&g_target, &Target::Method6, i, i, i, i, i, i); }
+    Task* MakeTaskString(int) { return base::NewMethodTask(&g_target, &Target::MethodString, std::string("a string longer than sso")); }
+
+    void BenchMethodTasks()
+    {
+        BenchMethodTask("arity_0", MakeTask0);
+        BenchMethodTask("arity_1", MakeTask1);
+        BenchMethodTask("arity_2", MakeTask2);
+        BenchMethodTask("arity_3", MakeTask3);
+        BenchMethodTask("arity_4", MakeTask4);
+        BenchMethodTask("arity_6", MakeTask6);
+        BenchMethodTask("string_arg", MakeTaskString);
+    }
+
+    /*
+     * per-object state updated from a pool: a lock per object on the
+     * work-stealing WorkerPool against a key per object on KeyedWorkerPool
+     */
+    class Session
+    {
+    public:
+        explicit Session(std::atomic<long>* done) : bytes_(0), done_(done) {}
+
+        void Receive(int bytes)
+        {
+            bytes_ += bytes;
+            done_->fetch_add(1, std::memory_order_release);
+        }
+
+        void LockedReceive(int bytes)
+        {
+            base::AutoLocker<base::CSLocker> guard(&locker_);
+            Receive(bytes);
+        }
+
+    private:
+        long long                        bytes_;
+        std::atomic<long>*               done_;
+        base::MultiThreadGuard<base::CSLocker> locker_;
+    };
+
+    void EnableRebalancing(base::WorkerPool*) {}
+
+    void EnableRebalancing(base::KeyedWorkerPool* pool)
+    {
+        pool->EnableRebalancing(2.0, 64);
+    }
+
+    template<typename Pool>
+    void BenchKeyedPool(const char* pool_name, bool locked, bool rebalance)
+    {
+        const int kSessions = 256;
+        const int kTasks = 1000000;
+
+        char name[96];
+        sprintf(name, "keyed_pool/%s", pool_name);
+        if (!Enabled(name))
+            return;
+
+        Pool pool(0);
+        if (rebalance)
+            EnableRebalancing(&pool);
+
+        std::atomic<long> done(0);
+        std::vector<Session*> sessions;
+        for (int i = 0; i < kSessions; ++i)
+            sessions.push_back(new Session(&done));
+
+        TimeTicks start = TimeTicks::Now();
+        for (int i = 0; i < kTasks; ++i)
+        {
+            Session* session = sessions[(i * 31) % kSessions];
+            pool.PostTask(locked ? base::NewMethodTask(session, &Session::LockedReceive, i & 1023)
+                                 : base::NewMethodTask(session, &Session::Receive, i & 1023));
+        }
+        double post_ns = NanosecondsSince(start);
+
+        while (done.load(std::memory_order_acquire) < kTasks)
+            std::this_thread::yield();
+        double total_ns = NanosecondsSince(start);
+
+        pool.Quit(0);
+        pool.Run();
+        for (int i = 0; i < kSessions; ++i)
+            delete sessions[i];
+
+        AddResult(name)
+            .Add("workers", std::thread::hardware_concurrency())
+            .Add("tasks", kTasks)
+            .Add("post_ns_per_task", post_ns / kTasks)
+            .Add("tasks_per_second", kTasks / (total_ns / 1e9));
+    }
+
+    void BenchKeyedPools()
+    {
+        BenchKeyedPool<base::WorkerPool>("worker_pool_locked", true, false);
+        BenchKeyedPool<base::KeyedWorkerPool>("keyed", false, false);
+        BenchKeyedPool<base::KeyedWorkerPool>("keyed_rebalance", false, true);
+    }
+
+    /*
+     * lock contention
+     */
+    template<typename Locker>
+    void BenchLock(const char* lock_name, int threads)
+    {
+        const int kTotalOps = 4000000;
+
+        char name[96];
+        sprintf(name, "lock/%s/threads_%d", lock_name, threads);
+        if (!Enabled(name))
+            return;
+
+        base::MultiThreadGuard<Locker> guard;
+        long long counter = 0;
+        int per_thread = kTotalOps / threads;
+
+        TimeTicks start = TimeTicks::Now();
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i)
+        {
+            workers.push_back(std::thread([&guard, &counter, per_thread]()
+            {
+                for (int j = 0; j < per_thread; ++j)
+                {
+                    base::AutoLocker<Locker> lock(&guard);
+                    ++counter;
+                }
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+        double elapsed_ns = NanosecondsSince(start);
+
+        long long ops = (long long)per_thread * threads;
+        AddResult(name)
+            .Add("threads", threads)
+            .Add("ops_per_second", ops / (elapsed_ns / 1e9))
+            .Add("ns_per_op", elapsed_ns / ops)
+            .Add("correct", counter == ops ? 1 : 0);
+    }
+
+    void BenchLocks()
+    {
+        // A FIFO lock hands over to a waiter that may not be running, so
+        // with more threads than cores every handoff is a context switch;
+        // that case only measures the scheduler.
+        int cores = (int)std::thread::hardware_concurrency();
+        for (int threads = 1; threads <= 64; threads *= 2)
+        {
+            BenchLock<base::CSLocker>("cs_locker", threads);
+            BenchLock<base::CSpinLock>("spin_lock", threads);
+            if (threads <= cores)
+            {
+                BenchLock<base::CTicketLock>("ticket_lock", threads);
+                BenchLock<base::CMcsLock>("mcs_lock", threads);
+            }
+            BenchLock<base::CRWLock>("rw_lock", threads);
+        }
+    }
+
+    // 1 write in 64 operations, readers under the shared mode when the
+    // lock has one
+    template<typename Locker>
+    struct ReadLocker
+    {
+        explicit ReadLocker(base::MultiThreadGuard<Locker>* guard) : lock_(guard) {}
+        base::AutoLocker<Locker> lock_;
+    };
+
+    template<>
+    struct ReadLocker<base::CRWLock>
+    {
+        explicit ReadLocker(base::MultiThreadGuard<base::CRWLock>* guard) : lock_(guard) {}
+        base::AutoSharedLocker<base::CRWLock> lock_;
+    };
+
+    template<typename Locker>
+    void BenchReadMostly(const char* lock_name, int threads)
+    {
+        const int kTotalOps = 4000000;
+        const int kWriteEvery = 64;
+
+        char name[96];
+        sprintf(name, "lock_read_mostly/%s/threads_%d", lock_name, threads);
+        if (!Enabled(name))
+            return;
+
+        base::MultiThreadGuard<Locker> guard;
+        long long table[8] = { 0 };
+        int per_thread = kTotalOps / threads;
+
+        TimeTicks start = TimeTicks::Now();
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i)
+        {
+            workers.push_back(std::thread([&guard, &table, per_thread]()
+            {
+                long long sum = 0;
+                for (int j = 0; j < per_thread; ++j)
+                {
+                    if (j % kWriteEvery == 0)
+                    {
+                        base::AutoLocker<Locker> lock(&guard);
+                        ++table[j & 7];
+                    }
+                    else
+                    {
+                        ReadLocker<Locker> lock(&guard);
+                        sum += table[j & 7];
+                    }
+                }
+                volatile long long sink = sum;
+                (void)sink;
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+        double elapsed_ns = NanosecondsSince(start);
+
+        long long ops = (long long)per_thread * threads;
+        AddResult(name)
+            .Add("threads", threads)
+            .Add("ops_per_second", ops / (elapsed_ns / 1e9))
+            .Add("ns_per_op", elapsed_ns / ops);
+    }
+
+    void BenchReadMostlyLocks()
+    {
+        for (int threads = 1; threads <= 64; threads *= 4)
+        {
+            BenchReadMostly<base::CSLocker>("cs_locker", threads);
+            BenchReadMostly<base::CRWLock>("rw_lock", threads);
+        }
+    }
+
+    /*
+     * Singleton::Instance() once created, against a load of a plain
+     * global pointer: the fast path should cost the same single load.
+     */
+    class Counter
+    {
+    public:
+        Counter() : value(0) {}
+        volatile long value;
+    };
+
+    Counter* volatile g_counter = 0;
+
+    struct GlobalPointerAccess
+    {
+        static Counter& Get() { return *g_counter; }
+    };
+
+    struct SingletonAccess
+    {
+        static Counter& Get() { return base::Singleton<Counter>::Instance(); }
+    };
+
+    struct ThreadLocalSingletonAccess
+    {
+        static Counter& Get()
+        {
+            return base::Singleton<Counter, base::ThreadLocalSingletonTraits<Counter> >::Instance();
+        }
+    };
+
+    template<typename Access>
+    void BenchSingletonAccess(const char* access_name)
+    {
+        const int kCalls = 50000000;
+        const int thread_counts[] = { 1, 4 };
+
+        for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i)
+        {
+            int threads = thread_counts[i];
+            char name[64];
+            sprintf(name, "singleton/%s/threads_%d", access_name, threads);
+            if (!Enabled(name))
+                continue;
+
+            int per_thread = kCalls / threads;
+            TimeTicks start = TimeTicks::Now();
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t)
+            {
+                workers.push_back(std::thread([per_thread]()
+                {
+                    long sum = 0;
+                    for (int j = 0; j < per_thread; ++j)
+                        sum += Access::Get().value;
+                    Access::Get().value = sum;
+                }));
+            }
+            for (size_t t = 0; t < workers.size(); ++t)
+                workers[t].join();
+            double elapsed_ns = NanosecondsSince(start);
+
+            AddResult(name)
+                .Add("threads", threads)
+                .Add("ns_per_call", elapsed_ns / per_thread);
+        }
+    }
+
+    void BenchSingleton()
+    {
+        g_counter = &base::Singleton<Counter>::Instance();
+
+        BenchSingletonAccess<GlobalPointerAccess>("global_pointer");
+        BenchSingletonAccess<SingletonAccess>("instance");
+        BenchSingletonAccess<ThreadLocalSingletonAccess>("thread_local");
+    }
+
+    /*
+     * A TRACE_EVENT scope with tracing off, which should cost one
+     * well-predicted branch, and on.
+     */
+    void BenchTraceEvent(const char* state, bool enabled)
+    {
+        const int kScopes = 10000000;
+
+        char name[64];
+        sprintf(name, "trace_event/scope/%s", state);
+        if (!Enabled(name))
+            return;
+
+        if (enabled)
+            base::TraceLog::Enable();
+
+        volatile int sink = 0;
+        TimeTicks start = TimeTicks::Now();
+        for (int i = 0; i < kScopes; ++i)
+        {
+            TRACE_EVENT("bench", "scope");
+            sink = i;
+        }
+        double elapsed_ns = NanosecondsSince(start);
+        (void)sink;
+
+        base::TraceLog::Disable();
+
+        AddResult(name)
+            .Add("ns_per_scope", elapsed_ns / kScopes);
+    }
+
+    void BenchTraceEvents()
+    {
+        BenchTraceEvent("disabled", false);
+        BenchTraceEvent("enabled", true);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* output = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+            g_filter = argv[i];
+    }
+
+    BenchPostTaskThroughput();
+    BenchCrossThread();
+    BenchSameThread();
+    BenchDelayQueues();
+    BenchMethodTasks();
+    BenchKeyedPools();
+    BenchLocks();
+    BenchReadMostlyLocks();
+    BenchSingleton();
+    BenchTraceEvents();
+
+    FILE* out = output ? fopen(output, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "cannot open %s\n", output);
+        return 1;
+    }
+
+    WriteJson(out);
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * Contention of CSpinLock against the lock it replaced.
+ *
+ * N threads share one counter guarded by the lock under test, with a
+ * short stretch of private work between critical sections. The legacy
+ * lock is the old exchange + sched_yield loop, kept here for reference.
+ *
+ *   g++ -std=c++11 -O2 -I. bench/spin_lock_bench.cpp base/locker.cpp base/futex.cpp \
+ *       -lpthread
+ */
+#include "base/locker.h"
+
+#include <chrono>
+#include <sched.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int kTotalOps = 1 << 22;
+
+    class LegacySpinLock
+    {
+    public:
+        LegacySpinLock() : locked_(0L) {}
+
+        void Lock()
+        {
+            while (__sync_lock_test_and_set(&locked_, 1L) == 1L)
+                sched_yield();
+        }
+
+        void Unlock()
+        {
+            __sync_lock_release(&locked_);
+        }
+
+    private:
+        volatile long locked_;
+    };
+
+    template<typename Locker>
+    double RunOnce(int threads, int outside_work)
+    {
+        base::MultiThreadGuard<Locker> guard;
+        long long counter = 0;
+        int per_thread = kTotalOps / threads;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i)
+        {
+            workers.push_back(std::thread([&guard, &counter, per_thread, outside_work]()
+            {
+                volatile int sink = 0;
+                for (int j = 0; j < per_thread; ++j)
+                {
+                    {
+                        base::AutoLocker<Locker> lock(&guard);
+                        ++counter;
+                    }
+
+                    for (int k = 0; k < outside_work; ++k)
+                        sink = sink + k;
+                }
+            }));
+        }
+
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (counter != (long long)per_thread * threads)
+            printf("lost updates!\n");
+
+        return counter / elapsed.count();
+    }
+}
+
+int main()
+{
+    const int outside_work[] = { 0, 100 };
+
+    for (size_t w = 0; w < sizeof(outside_work) / sizeof(outside_work[0]); ++w)
+    {
+        printf("private work %d iterations between locks\n", outside_work[w]);
+        printf("%-8s %16s %16s %16s\n", "threads", "legacy (op/s)", "spin (op/s)", "cs_locker (op/s)");
+        for (int threads = 1; threads <= 64; threads *= 2)
+        {
+            double legacy = RunOnce<LegacySpinLock>(threads, outside_work[w]);
+            double spin = RunOnce<base::CSpinLock>(threads, outside_work[w]);
+            double mutex = RunOnce<base::CSLocker>(threads, outside_work[w]);
+            printf("%-8d %16.0f %16.0f %16.0f\n", threads, legacy, spin, mutex);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Producer scaling of the TaskCenter task queue.
+ *
+ * N producer threads push a fixed total of tasks into one queue while a
+ * single consumer pops them, for the old std::queue + CSLocker queue and
+ * for MpscTaskQueue.
+ *
+ *   g++ -std=c++11 -O2 -I. bench/task_queue_bench.cpp \
+ *       base/locker.cpp base/futex.cpp base/task.cpp base/task_allocator.cpp \
+ *       base/mpsc_task_queue.cpp -lpthread
+ */
+#include "base/locker.h"
+#include "base/mpsc_task_queue.h"
+#include "base/task.h"
+
+#include <chrono>
+#include <queue>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int kTotalTasks = 1 << 21;
+
+    class NopTask : public base::Task
+    {
+    public:
+        virtual void Run() {}
+    };
+
+    class LockedTaskQueue
+    {
+    public:
+        void Push(base::Task* task)
+        {
+            base::AutoLocker<base::CSLocker> guard(&locker_);
+            queue_.push(task);
+        }
+
+        base::Task* Pop()
+        {
+            base::AutoLocker<base::CSLocker> guard(&locker_);
+            if (queue_.empty())
+                return 0;
+
+            base::Task* task = queue_.front();
+            queue_.pop();
+            return task;
+        }
+
+    private:
+        base::MultiThreadGuard<base::CSLocker> locker_;
+        std::queue<base::Task*>                queue_;
+    };
+
+    template<typename Queue>
+    double RunOnce(int producers)
+    {
+        Queue queue;
+        std::vector<NopTask> tasks(kTotalTasks);
+        int per_producer = kTotalTasks / producers;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < producers; ++i)
+        {
+            NopTask* first = &tasks[i * per_producer];
+            threads.push_back(std::thread([&queue, first, per_producer]()
+            {
+                for (int j = 0; j < per_producer; ++j)
+                    queue.Push(first + j);
+            }));
+        }
+
+        int popped = 0;
+        int expected = per_producer * producers;
+        while (popped < expected)
+        {
+            base::Task* task = queue.Pop();
+            if (task)
+            {
+                task->Run();
+                ++popped;
+            }
+        }
+
+        for (size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return expected / elapsed.count();
+    }
+}
+
+int main()
+{
+    printf("%-10s %18s %18s\n", "producers", "locked (task/s)", "mpsc (task/s)");
+    for (int producers = 1; producers <= 32; producers *= 2)
+    {
+        double locked = RunOnce<LockedTaskQueue>(producers);
+        double mpsc = RunOnce<base::MpscTaskQueue>(producers);
+        printf("%-10d %18.0f %18.0f\n", producers, locked, mpsc);
+    }
+
+    return 0;
+}
@@ -1,11 +1,18 @@
 #include "base/task_center.hpp"
-#include "base/message_pump.hpp"
 #include "base/task.h"
 #include "base/singleton.h"
 
 #include <iostream>
+#include <stdio.h>
 #include <string>
 
+// the message loop on Windows, epoll elsewhere
+#if defined(_WIN32)
+typedef TaskCenterUI MainTaskCenter;
+#else
+typedef TaskCenterIO MainTaskCenter;
+#endif
+
 
 class TestClass
 {
@@ -32,7 +39,7 @@ public:
     void Test3(std::string s)
     {
         std::cout<<s<<std::endl;
-        base::Singleton<TaskCenterUI>::Instance().Quit(3);
+        MainTaskCenter::Current()->Quit(3);
     }
 
 private:
@@ -50,11 +57,11 @@ int main()
     base::Task* task3 = base::NewMethodTask(&test_class, &TestClass::Test3, s);
 
     
-    base::Singleton<TaskCenterUI>::Instance().PostTask(task);
-    base::Singleton<TaskCenterUI>::Instance().PostTask(task2);
+    base::Singleton<MainTaskCenter>::Instance().PostTask(task);
+    base::Singleton<MainTaskCenter>::Instance().PostTask(task2);
 
-    base::Singleton<TaskCenterUI>::Instance().PostTask(task3);
-    base::Singleton<TaskCenterUI>::Instance().Run();
+    base::Singleton<MainTaskCenter>::Instance().PostTask(task3);
+    base::Singleton<MainTaskCenter>::Instance().Run();
 
     ::getchar();
 }
\ No newline at end of file
@@ -0,0 +1,128 @@
+/*
+ * Stress test for SequencedTaskRunner: producers on several threads
+ * post to a few sequences on a WorkerPool, and every task checks that
+ * no other task of its sequence is running and that tasks of one
+ * producer run in posting order.
+ *
+ *   g++ -std=c++11 -O2 -I. test/sequenced_task_runner_test.cpp \
+ *       $(find base -name '*.cpp') -lpthread -o sequenced_task_runner_test
+ *   ./sequenced_task_runner_test
+ */
+#include "base/sequenced_task_runner.h"
+#include "base/task.h"
+#include "base/time_ticks.h"
+#include "base/worker_pool.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int kSequences = 4;
+    const int kProducers = 4;
+    const int kTasksPerProducer = 50000;
+
+    std::atomic<int> g_failures(0);
+
+    void Check(bool condition, const char* what)
+    {
+        if (!condition && g_failures.fetch_add(1) == 0)
+            fprintf(stderr, "FAILED: %s\n", what);
+    }
+
+    struct Sequence
+    {
+        Sequence(base::WorkerPool* pool) : runner(pool), running(0), done(0)
+        {
+            for (int i = 0; i < kProducers; ++i)
+                last[i] = -1;
+        }
+
+        base::SequencedTaskRunner runner;
+        std::atomic<int>          running;
+        std::atomic<int>          done;
+        int                       last[kProducers];
+    };
+
+    void RunOne(Sequence* sequence, int producer, int index)
+    {
+        Check(sequence->running.exchange(1, std::memory_order_acquire) == 0,
+              "two tasks of one sequence overlap");
+        Check(sequence->runner.RunsTasksInCurrentSequence(), "task runs outside its sequence");
+
+        // unsynchronised on purpose, the sequence is the only lock
+        Check(sequence->last[producer] == index - 1, "tasks of one producer run out of order");
+        sequence->last[producer] = index;
+
+        // a little work, so a second copy of the sequence started by a
+        // miscount gets the chance to run alongside
+        volatile int spin = 0;
+        while (spin < 100)
+            spin = spin + 1;
+
+        sequence->running.store(0, std::memory_order_release);
+        sequence->done.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int main()
+{
+    base::WorkerPool pool(4);
+
+    std::vector<Sequence*> sequences;
+    for (int i = 0; i < kSequences; ++i)
+        sequences.push_back(new Sequence(&pool));
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.push_back(std::thread([p, &sequences]() {
+            for (int i = 0; i < kTasksPerProducer; ++i)
+            {
+                Sequence* sequence = sequences[(i + p) % kSequences];
+                int index = i / kSequences;
+                sequence->runner.PostTask(base::NewCallableTask([sequence, p, index]() {
+                    RunOne(sequence, p, index);
+                }));
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < producers.size(); ++i)
+        producers[i].join();
+
+    // a miscounted sequence can also strand tasks, which shows as a timeout
+    int expected = kProducers * kTasksPerProducer;
+    base::TimeTicks deadline = base::TimeTicks::Now() + base::TimeDelta::FromSeconds(30);
+    while (true)
+    {
+        int done = 0;
+        for (int i = 0; i < kSequences; ++i)
+            done += sequences[i]->done.load(std::memory_order_relaxed);
+        if (done >= expected || g_failures.load())
+            break;
+
+        if (base::TimeTicks::Now() >= deadline)
+        {
+            Check(false, "tasks still not run after 30 seconds");
+            break;
+        }
+        std::this_thread::yield();
+    }
+
+    pool.Quit(0);
+    pool.Run();
+    for (int i = 0; i < kSequences; ++i)
+        delete sequences[i];
+
+    if (g_failures.load())
+    {
+        fprintf(stderr, "%d failures\n", g_failures.load());
+        return 1;
+    }
+
+    printf("sequenced_task_runner_test: %d tasks, ok\n", expected);
+    return 0;
+}
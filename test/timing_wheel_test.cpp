@@ -0,0 +1,105 @@
+/*
+ * Checks that TimingWheel never hands a task out late: a timer comes
+ * out of PopExpired at its expire tick, not before and not after, also
+ * when it sits on an upper level and expires right on a cascade
+ * boundary, and NextExpireTime never reports a time past it.
+ *
+ *   g++ -std=c++11 -O2 -I. test/timing_wheel_test.cpp \
+ *       $(find base -name '*.cpp') -lpthread -o timing_wheel_test
+ *   ./timing_wheel_test
+ */
+#include "base/task.h"
+#include "base/time_ticks.h"
+#include "base/timing_wheel.h"
+
+#include <stdio.h>
+
+namespace
+{
+    const long long kTickNanoseconds = 1000000;
+
+    int g_failures = 0;
+
+    void Check(bool condition, const char* what, long long tick)
+    {
+        if (!condition)
+        {
+            ++g_failures;
+            fprintf(stderr, "FAILED: %s, expire tick %lld\n", what, tick);
+        }
+    }
+
+    base::TimeTicks AtTick(long long tick)
+    {
+        return base::TimeTicks::FromInternalValue(tick * kTickNanoseconds);
+    }
+
+    // one timer in a fresh wheel, expiring offset ticks after a multiple
+    // of boundary at least boundary ticks away, so it starts on an upper
+    // level and only comes down at the cascade
+    void CheckTimer(long long boundary, long long offset)
+    {
+        base::TimingWheel wheel;
+        long long start = base::TimeTicks::Now().ToInternalValue() / kTickNanoseconds + 1;
+        long long expire_tick = (start / boundary + 2) * boundary + offset;
+
+        base::Task* task = base::NewCallableTask([]() {});
+        wheel.Push(task, AtTick(expire_tick));
+
+        // walk up the way a pump does, waking at each NextExpireTime
+        long long now = start;
+        while (true)
+        {
+            long long next = wheel.NextExpireTime().ToInternalValue() / kTickNanoseconds;
+            Check(next <= expire_tick, "next expire time late", expire_tick);
+            if (next >= expire_tick || next <= now)
+                break;
+
+            now = next;
+            Check(!wheel.PopExpired(AtTick(now)), "popped early", expire_tick);
+        }
+
+        Check(!wheel.PopExpired(AtTick(expire_tick - 1)), "popped early", expire_tick);
+        base::Task* popped = wheel.PopExpired(AtTick(expire_tick));
+        Check(popped == task, "not popped at its expire tick", expire_tick);
+        Check(wheel.Empty(), "wheel not empty", expire_tick);
+
+        if (!popped)
+            popped = wheel.PopExpired(AtTick(expire_tick + (1LL << 32)));
+        delete popped;
+    }
+}
+
+int main()
+{
+    const long long boundaries[] = { 256, 65536 };
+    for (int i = 0; i < 2; ++i)
+    {
+        for (long long offset = -2; offset <= 2; ++offset)
+            CheckTimer(boundaries[i], offset);
+    }
+
+    // a timer already due is handed out by the next PopExpired
+    {
+        base::TimingWheel wheel;
+        long long now = base::TimeTicks::Now().ToInternalValue() / kTickNanoseconds + 1;
+        wheel.PopExpired(AtTick(now));
+
+        base::Task* task = base::NewCallableTask([]() {});
+        wheel.Push(task, AtTick(now));
+        base::Task* popped = wheel.PopExpired(AtTick(now));
+        Check(popped == task, "due timer not popped", now);
+        if (!popped)
+            popped = wheel.PopExpired(AtTick(now + 1));
+        delete popped;
+    }
+
+    if (g_failures)
+    {
+        fprintf(stderr, "%d failures\n", g_failures);
+        return 1;
+    }
+
+    printf("timing_wheel_test: ok\n");
+    return 0;
+}